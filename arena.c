@@ -0,0 +1,141 @@
+/*
+ * arena.c
+ *
+ *  Created on: Oct 19, 2026
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stddef.h>
+
+#include "memp.h"
+#include "mempool.h"
+#include "arena.h"
+
+#define ARENA_CHUNK_HDR_SIZE MEMP_ALIGN_SIZE(sizeof(struct arena_chunk))
+
+/** Round a pointer up to ARENA_ALIGNMENT */
+#define ARENA_ALIGN(addr) \
+	((uint8_t*) (((uintptr_t) (addr) + ARENA_ALIGNMENT - 1U) & ~(uintptr_t) (ARENA_ALIGNMENT - 1U)))
+
+/**
+ * Take a new chunk able to hold at least 'size' bytes from the malloc pools
+ * and make it the current chunk of the arena.
+ *
+ * @param arena
+ * @param size the size in bytes the new chunk must be able to hold
+ * @return the new chunk or NULL if no pool can provide one
+ */
+static struct arena_chunk *
+arena_chunk_new (struct arena *arena, size_t size)
+{
+	struct arena_chunk *chunk = NULL;
+	memp_t poolnr;
+#if MEMP_STATS && MEMP_STATS_MALLOC
+	memp_t fitting = MEMP_MAX;
+#endif /* MEMP_STATS && MEMP_STATS_MALLOC */
+	size_t required_size = size + ARENA_CHUNK_HDR_SIZE + ARENA_ALIGNMENT - 1U;
+
+	for (poolnr = MEMP_POOL_FIRST; poolnr <= MEMP_POOL_LAST; poolnr = (memp_t) (poolnr + 1))
+	{
+		if (memp_pools[poolnr]->size < ARENA_CHUNK_MIN_SIZE || required_size > memp_pools[poolnr]->size)
+		{
+			continue;
+		}
+#if MEMP_STATS && MEMP_STATS_MALLOC
+		if (fitting == MEMP_MAX)
+		{
+			fitting = poolnr;
+		}
+#endif /* MEMP_STATS && MEMP_STATS_MALLOC */
+		chunk = (struct arena_chunk*) memp_malloc(poolnr);
+		if (chunk != NULL)
+		{
+			break;
+		}
+		/* this pool is empty, try the next one that is big enough */
+	}
+	if (chunk == NULL)
+	{
+#if MEMP_LOG
+		printf("arena_malloc(): no chunk available for %lu bytes!\n", (unsigned long) size);
+#endif
+		return NULL;
+	}
+#if MEMP_STATS && MEMP_STATS_MALLOC
+	/* the arena fills the whole element */
+	mempool_stats_malloc (poolnr, fitting, memp_pools[poolnr]->size);
+#endif /* MEMP_STATS && MEMP_STATS_MALLOC */
+
+	chunk->poolnr = poolnr;
+	chunk->next = arena->chunks;
+	arena->chunks = chunk;
+	arena->ptr = (uint8_t*) chunk + ARENA_CHUNK_HDR_SIZE;
+	arena->end = (uint8_t*) chunk + memp_pools[poolnr]->size;
+
+	return chunk;
+}
+
+/**
+ * Init an empty arena
+ * @param arena
+ */
+void
+arena_init (struct arena *arena)
+{
+	mempool_init ();
+
+	arena->chunks = NULL;
+	arena->ptr = NULL;
+	arena->end = NULL;
+}
+
+/**
+ * Allocate memory from an arena by bumping its pointer, aligned to
+ * ARENA_ALIGNMENT. A new chunk is taken from the pools when the current
+ * one is full.
+ *
+ * @param arena
+ * @param size the size in bytes of the memory needed
+ * @return a pointer to the allocated memory or NULL
+ */
+void *
+arena_malloc (struct arena *arena, size_t size)
+{
+	uint8_t *ret;
+
+	ret = ARENA_ALIGN(arena->ptr);
+	if (arena->ptr == NULL || ret > arena->end || size > (size_t) (arena->end - ret))
+	{
+		if (arena_chunk_new (arena, size) == NULL)
+		{
+			return NULL;
+		}
+		ret = ARENA_ALIGN(arena->ptr);
+	}
+
+	arena->ptr = ret + size;
+	return ret;
+}
+
+/**
+ * Release all allocations of an arena, every chunk goes back to its pool
+ * @param arena
+ */
+void
+arena_reset (struct arena *arena)
+{
+	struct arena_chunk *chunk;
+
+	while (arena->chunks != NULL)
+	{
+		chunk = arena->chunks;
+		arena->chunks = chunk->next;
+#if MEMP_STATS && MEMP_STATS_MALLOC
+		mempool_stats_free (chunk->poolnr, memp_pools[chunk->poolnr]->size);
+#endif /* MEMP_STATS && MEMP_STATS_MALLOC */
+		memp_free (chunk->poolnr, chunk);
+	}
+
+	arena->ptr = NULL;
+	arena->end = NULL;
+}
@@ -0,0 +1,71 @@
+/*
+ * arena.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "memp.h"
+
+/**
+ * Minimal element size of a pool used as arena chunk source.
+ * Smaller malloc pools are never used by an arena.
+ */
+#define ARENA_CHUNK_MIN_SIZE	1024
+
+/** Alignment of every arena allocation, enough for any object type */
+#ifndef ARENA_ALIGNMENT
+#define ARENA_ALIGNMENT	_Alignof(max_align_t)
+#endif
+
+/** Header stored at the beginning of every chunk taken from a pool */
+struct arena_chunk {
+  /** Next chunk owned by the same arena */
+  struct arena_chunk *next;
+  /** Pool this chunk came from */
+  memp_t poolnr;
+};
+
+/**
+ * Bump arena. Sub-allocations are carved out of pool elements (chunks)
+ * without any per-object header and are released all at once by arena_reset.
+ */
+struct arena {
+  /** Chunks owned by this arena, most recent first */
+  struct arena_chunk *chunks;
+  /** Next free byte in the current chunk */
+  uint8_t *ptr;
+  /** End of the current chunk */
+  uint8_t *end;
+};
+
+/**
+ * Init an empty arena. No memory is taken from the pools until
+ * the first arena_malloc.
+ * @param arena
+ */
+void arena_init(struct arena *arena);
+
+/**
+ * Allocate memory from an arena, aligned to ARENA_ALIGNMENT. The memory
+ * stays valid until the next arena_reset, it cannot be freed individually.
+ * @param arena
+ * @param size the size in bytes of the memory needed
+ * @return a pointer to the allocated memory or NULL if no pool chunk
+ *         big enough is available
+ */
+void *arena_malloc(struct arena *arena, size_t size);
+
+/**
+ * Release every allocation of an arena at once and give
+ * all its chunks back to their pools.
+ * @param arena
+ */
+void arena_reset(struct arena *arena);
+
+#endif /* ARENA_H_ */
@@ -0,0 +1,92 @@
+/*
+ * bench_arena.c
+ *
+ *  Created on: Oct 19, 2026
+ *
+ * Benchmark of arena_malloc/arena_reset against per-object
+ * mempool_malloc/mempool_free for short lived request allocations.
+ *
+ * Build (without the per-call pool walk of MEMP_OVERFLOW_CHECK 2):
+ *	gcc -O2 -DMEMP_OVERFLOW_CHECK=0 memp.c mempool.c arena.c bench_arena.c -o bench_arena
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "memp.h"
+#include "mempool.h"
+#include "arena.h"
+
+/** Allocations made by one request */
+#define BENCH_OBJECTS	20
+/** Number of requests */
+#define BENCH_ROUNDS	1000000
+
+static const size_t bench_sizes[BENCH_OBJECTS] = {
+	16, 24, 40, 64, 32, 16, 48, 24, 56, 40,
+	16, 32, 64, 24, 16, 40, 48, 32, 24, 16
+};
+
+static double
+bench_now (void)
+{
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+int
+main (void)
+{
+	void *objs[BENCH_OBJECTS];
+	struct arena arena;
+	double start, t_pool, t_arena;
+	long round;
+	int i;
+
+	arena_init (&arena);
+
+	start = bench_now ();
+	for (round = 0; round < BENCH_ROUNDS; round++)
+	{
+		for (i = 0; i < BENCH_OBJECTS; i++)
+		{
+			objs[i] = mempool_malloc (bench_sizes[i]);
+			if (objs[i] == NULL)
+			{
+				printf ("mempool_malloc failed\n");
+				return 1;
+			}
+			*(volatile uint8_t*) objs[i] = (uint8_t) i;
+		}
+		for (i = 0; i < BENCH_OBJECTS; i++)
+		{
+			mempool_free (objs[i]);
+		}
+	}
+	t_pool = bench_now () - start;
+
+	start = bench_now ();
+	for (round = 0; round < BENCH_ROUNDS; round++)
+	{
+		for (i = 0; i < BENCH_OBJECTS; i++)
+		{
+			objs[i] = arena_malloc (&arena, bench_sizes[i]);
+			if (objs[i] == NULL)
+			{
+				printf ("arena_malloc failed\n");
+				return 1;
+			}
+			*(volatile uint8_t*) objs[i] = (uint8_t) i;
+		}
+		arena_reset (&arena);
+	}
+	t_arena = bench_now () - start;
+
+	printf ("%d objects x %d requests\n", BENCH_OBJECTS, BENCH_ROUNDS);
+	printf ("mempool_malloc/free: %8.2f ns/object\n", t_pool * 1e9 / ((double) BENCH_ROUNDS * BENCH_OBJECTS));
+	printf ("arena_malloc/reset:  %8.2f ns/object\n", t_arena * 1e9 / ((double) BENCH_ROUNDS * BENCH_OBJECTS));
+	return 0;
+}
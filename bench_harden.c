@@ -0,0 +1,73 @@
+/*
+ * bench_harden.c
+ *
+ *  Created on: Oct 19, 2026
+ *
+ * Cost of the MEMP_HARDEN options on mempool_malloc/mempool_free.
+ * Build once per configuration and compare:
+ *	gcc -O2 -DMEMP_OVERFLOW_CHECK=0 memp.c mempool.c bench_harden.c -o bench_harden
+ *	gcc -O2 -DMEMP_OVERFLOW_CHECK=0 -DMEMP_HARDEN=1 memp.c mempool.c bench_harden.c -o bench_harden
+ *	gcc -O2 -DMEMP_OVERFLOW_CHECK=0 -DMEMP_HARDEN=1 -DMEMP_HARDEN_POISON=1 memp.c mempool.c bench_harden.c -o bench_harden
+ *	gcc -O2 -DMEMP_OVERFLOW_CHECK=0 -DMEMP_HARDEN=1 -DMEMP_HARDEN_QUARANTINE=4 memp.c mempool.c bench_harden.c -o bench_harden
+ *	gcc -O2 -DMEMP_OVERFLOW_CHECK=0 -DMEMP_HARDEN=1 -DMEMP_HARDEN_GUARD=1 memp.c mempool.c bench_harden.c -o bench_harden
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "memp.h"
+#include "mempool.h"
+
+/** Allocations alive at the same time */
+#define BENCH_OBJECTS	8
+/** Number of rounds */
+#define BENCH_ROUNDS	1000000
+
+static const size_t bench_sizes[BENCH_OBJECTS] = {
+	64, 200, 480, 32, 900, 128, 300, 16
+};
+
+static double
+bench_now (void)
+{
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+int
+main (void)
+{
+	void *objs[BENCH_OBJECTS];
+	double start, elapsed;
+	long round;
+	int i;
+
+	mempool_init ();
+
+	start = bench_now ();
+	for (round = 0; round < BENCH_ROUNDS; round++)
+	{
+		for (i = 0; i < BENCH_OBJECTS; i++)
+		{
+			objs[i] = mempool_malloc (bench_sizes[i]);
+			if (objs[i] == NULL)
+			{
+				printf ("mempool_malloc failed\n");
+				return 1;
+			}
+			*(volatile uint8_t*) objs[i] = (uint8_t) i;
+		}
+		for (i = 0; i < BENCH_OBJECTS; i++)
+		{
+			mempool_free (objs[i]);
+		}
+	}
+	elapsed = bench_now () - start;
+
+	printf ("MEMP_HARDEN %d, POISON %d, QUARANTINE %d, GUARD %d: %8.2f ns/object\n", MEMP_HARDEN,
+			MEMP_HARDEN && MEMP_HARDEN_POISON, MEMP_HARDEN ? MEMP_HARDEN_QUARANTINE : 0,
+			MEMP_HARDEN && MEMP_HARDEN_GUARD, elapsed * 1e9 / ((double) BENCH_ROUNDS * BENCH_OBJECTS));
+	return 0;
+}
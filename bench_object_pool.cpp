@@ -0,0 +1,116 @@
+/*
+ * bench_object_pool.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *
+ * Benchmark of ObjectPool<T, N>::make against new/delete and
+ * std::make_unique for a batch of short lived objects.
+ *
+ * Build with the inlined freelist pop/push of ObjectPool:
+ *	gcc -O2 -DMEMP_OVERFLOW_CHECK=0 -DMEMP_HARDEN=0 -c memp.c
+ *	g++ -std=c++17 -O2 -DMEMP_OVERFLOW_CHECK=0 -DMEMP_HARDEN=0 memp.o bench_object_pool.cpp -o bench_object_pool
+ * and without the -D options to measure the checked path of the defaults.
+ */
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+
+#include "object_pool.hpp"
+
+/** Objects alive at the same time */
+#define BENCH_OBJECTS	64
+/** Number of batches */
+#define BENCH_ROUNDS	1000000
+
+struct bench_obj
+{
+	uint64_t id;
+	uint64_t data[7];
+
+	explicit bench_obj (uint64_t i) : id (i), data ()
+	{
+	}
+};
+
+using bench_pool = ObjectPool<bench_obj, BENCH_OBJECTS>;
+
+static double
+bench_now ()
+{
+	return std::chrono::duration<double> (std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+}
+
+/** Run BENCH_ROUNDS batches of 'alloc' then 'release', return ns per object */
+template <typename Alloc, typename Release>
+static double
+bench_run (const char *what, Alloc alloc, Release release)
+{
+	double start;
+	long round;
+	int i;
+
+	start = bench_now ();
+	for (round = 0; round < BENCH_ROUNDS; round++)
+	{
+		for (i = 0; i < BENCH_OBJECTS; i++)
+		{
+			if (!alloc (i))
+			{
+				std::printf ("%s failed\n", what);
+				return -1;
+			}
+		}
+		for (i = 0; i < BENCH_OBJECTS; i++)
+		{
+			release (i);
+		}
+	}
+	return (bench_now () - start) * 1e9 / ((double) BENCH_ROUNDS * BENCH_OBJECTS);
+}
+
+int
+main ()
+{
+	static bench_pool::Handle pool_objs[BENCH_OBJECTS];
+	static std::unique_ptr<bench_obj> heap_objs[BENCH_OBJECTS];
+	static bench_obj *raw_objs[BENCH_OBJECTS];
+	double t_pool, t_new, t_unique;
+
+	t_pool = bench_run ("ObjectPool::make", [] (int i)
+	{
+		pool_objs[i] = bench_pool::make ((uint64_t) i);
+		return pool_objs[i] != nullptr;
+	}, [] (int i)
+	{
+		pool_objs[i].reset ();
+	});
+
+	t_new = bench_run ("new", [] (int i)
+	{
+		raw_objs[i] = new bench_obj ((uint64_t) i);
+		/* keep the compiler from eliding the pair */
+		asm volatile ("" : : "r" (raw_objs[i]) : "memory");
+		return true;
+	}, [] (int i)
+	{
+		delete raw_objs[i];
+	});
+
+	t_unique = bench_run ("std::make_unique", [] (int i)
+	{
+		heap_objs[i] = std::make_unique<bench_obj> ((uint64_t) i);
+		asm volatile ("" : : "r" (heap_objs[i].get ()) : "memory");
+		return true;
+	}, [] (int i)
+	{
+		heap_objs[i].reset ();
+	});
+
+	std::printf ("%d objects of %zu bytes x %d batches (MEMP_OVERFLOW_CHECK %d, MEMP_HARDEN %d)\n", BENCH_OBJECTS,
+			sizeof(bench_obj), BENCH_ROUNDS, MEMP_OVERFLOW_CHECK, MEMP_HARDEN);
+	std::printf ("ObjectPool::make:  %8.2f ns/object\n", t_pool);
+	std::printf ("new/delete:        %8.2f ns/object\n", t_new);
+	std::printf ("std::make_unique:  %8.2f ns/object\n", t_unique);
+	return 0;
+}
@@ -0,0 +1,173 @@
+/*
+ * bench_percpu.c
+ *
+ *  Created on: Oct 19, 2026
+ *
+ * Benchmark of memp_percpu_malloc/memp_percpu_free against memp_malloc/
+ * memp_free behind one mutex, with many more threads than CPUs. Every
+ * thread holds one element at a time, so the pool never runs out: any
+ * NULL means elements were stuck in the cache of another CPU.
+ *
+ * Build (without the per-call pool walk of MEMP_OVERFLOW_CHECK 2):
+ *	gcc -O2 -DMEMP_OVERFLOW_CHECK=0 memp.c memp_percpu.c bench_percpu.c -o bench_percpu -lpthread
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "memp.h"
+#include "memp_percpu.h"
+
+/** Threads per CPU */
+#define BENCH_THREADS_PER_CPU	8
+/** Allocations made by every thread */
+#define BENCH_ROUNDS	200000
+/** The pool used, has to have more elements than the benchmark has threads */
+#define BENCH_POOL	MEMP_POOL_1024
+
+static pthread_mutex_t bench_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_barrier_t bench_start;
+
+struct bench_thread {
+	pthread_t thread;
+	int percpu;
+	unsigned long empty;
+};
+
+static double
+bench_now (void)
+{
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+static void *
+bench_thread (void *arg)
+{
+	struct bench_thread *bt = (struct bench_thread*) arg;
+	void *p;
+	long round;
+
+	pthread_barrier_wait (&bench_start);
+	for (round = 0; round < BENCH_ROUNDS; round++)
+	{
+		if (bt->percpu)
+		{
+			p = memp_percpu_malloc (BENCH_POOL);
+		}
+		else
+		{
+			pthread_mutex_lock (&bench_lock);
+			p = memp_malloc (BENCH_POOL);
+			pthread_mutex_unlock (&bench_lock);
+		}
+		if (p == NULL)
+		{
+			bt->empty++;
+			continue;
+		}
+		*(volatile uint8_t*) p = (uint8_t) round;
+		if (bt->percpu)
+		{
+			memp_percpu_free (BENCH_POOL, p);
+		}
+		else
+		{
+			pthread_mutex_lock (&bench_lock);
+			memp_free (BENCH_POOL, p);
+			pthread_mutex_unlock (&bench_lock);
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Run every thread through BENCH_ROUNDS allocations
+ * @return ns per allocation and free, over all threads
+ */
+static double
+bench_run (struct bench_thread *threads, int nthreads, int percpu, unsigned long *empty)
+{
+	double start;
+	int i;
+
+	pthread_barrier_init (&bench_start, NULL, (unsigned) nthreads + 1);
+	for (i = 0; i < nthreads; i++)
+	{
+		threads[i].percpu = percpu;
+		threads[i].empty = 0;
+		if (pthread_create (&threads[i].thread, NULL, bench_thread, &threads[i]) != 0)
+		{
+			printf ("pthread_create failed\n");
+			exit (1);
+		}
+	}
+	pthread_barrier_wait (&bench_start);
+	start = bench_now ();
+	*empty = 0;
+	for (i = 0; i < nthreads; i++)
+	{
+		pthread_join (threads[i].thread, NULL);
+		*empty += threads[i].empty;
+	}
+	pthread_barrier_destroy (&bench_start);
+	return (bench_now () - start) * 1e9 / ((double) nthreads * BENCH_ROUNDS);
+}
+
+int
+main (void)
+{
+	struct bench_thread *threads;
+	void *held[MEMP_PERCPU_BATCH * 4];
+	unsigned long empty_lock, empty_percpu;
+	double t_lock, t_percpu;
+	long ncpus;
+	int nthreads;
+	int recovered;
+
+	ncpus = sysconf (_SC_NPROCESSORS_ONLN);
+	nthreads = (int) (ncpus > 0 ? ncpus : 1) * BENCH_THREADS_PER_CPU;
+	if ((memp_count_t) nthreads > memp_pools[BENCH_POOL]->num)
+	{
+		/* keep "never runs out" true, the pools of pools.h are small */
+		nthreads = (int) memp_pools[BENCH_POOL]->num;
+	}
+	threads = (struct bench_thread*) calloc ((size_t) nthreads, sizeof(*threads));
+	if (threads == NULL)
+	{
+		return 1;
+	}
+
+	memp_init ();
+
+	t_lock = bench_run (threads, nthreads, 0, &empty_lock);
+	t_percpu = bench_run (threads, nthreads, 1, &empty_percpu);
+
+	/* every element has to be reachable again, wherever it is cached */
+	for (recovered = 0; recovered < (int) (sizeof(held) / sizeof(held[0])); recovered++)
+	{
+		held[recovered] = memp_percpu_malloc (BENCH_POOL);
+		if (held[recovered] == NULL)
+		{
+			break;
+		}
+	}
+
+	printf ("%d threads on %ld CPUs, %d allocations each, pool of %lu elements\n", nthreads, ncpus, BENCH_ROUNDS,
+			(unsigned long) memp_pools[BENCH_POOL]->num);
+	printf ("memp_malloc/free + mutex:  %8.2f ns/op, %lu NULL\n", t_lock, empty_lock);
+	printf ("memp_percpu_malloc/free:   %8.2f ns/op, %lu NULL\n", t_percpu, empty_percpu);
+	printf ("elements recovered after the run: %d of %lu\n", recovered, (unsigned long) memp_pools[BENCH_POOL]->num);
+
+	while (recovered > 0)
+	{
+		memp_percpu_free (BENCH_POOL, held[--recovered]);
+	}
+	free (threads);
+	return 0;
+}
@@ -0,0 +1,111 @@
+/*
+ * bench_resource.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *
+ * Benchmark of pmr containers on mempool_resource against
+ * std::pmr::new_delete_resource. Every container is filled on its own
+ * and kept small enough for the 30 elements of the malloc pools declared
+ * in pools.h.
+ *
+ * Build (without the per-call pool walk of MEMP_OVERFLOW_CHECK 2):
+ *	gcc -O2 -DMEMP_OVERFLOW_CHECK=0 -c memp.c mempool.c
+ *	g++ -std=c++17 -O2 -DMEMP_OVERFLOW_CHECK=0 memp.o mempool.o bench_resource.cpp -o bench_resource
+ */
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <list>
+#include <map>
+#include <memory_resource>
+#include <unordered_map>
+#include <vector>
+
+#include "mempool_resource.hpp"
+
+/** Elements put into every container */
+#define BENCH_ELEMENTS	16
+/** Number of times every container is filled and destroyed */
+#define BENCH_ROUNDS	200000
+
+static double
+bench_now ()
+{
+	return std::chrono::duration<double> (std::chrono::steady_clock::now ().time_since_epoch ()).count ();
+}
+
+/** Fill and destroy container C 'rounds' times, return ns per round */
+template <typename C, typename Fill>
+static double
+bench_run (std::pmr::memory_resource *mr, Fill fill)
+{
+	double start;
+	long round;
+
+	start = bench_now ();
+	for (round = 0; round < BENCH_ROUNDS; round++)
+	{
+		C c (mr);
+
+		fill (c);
+		asm volatile ("" : : "r" (&c) : "memory");
+	}
+	return (bench_now () - start) * 1e9 / BENCH_ROUNDS;
+}
+
+/** Run every container on one resource */
+static void
+bench_resource (const char *what, std::pmr::memory_resource *mr)
+{
+	double t_vec, t_list, t_map, t_umap;
+
+	t_vec = bench_run<std::pmr::vector<uint32_t>> (mr, [] (std::pmr::vector<uint32_t> &c)
+	{
+		for (int i = 0; i < BENCH_ELEMENTS; i++)
+		{
+			c.push_back ((uint32_t) i);
+		}
+	});
+	t_list = bench_run<std::pmr::list<uint64_t>> (mr, [] (std::pmr::list<uint64_t> &c)
+	{
+		for (int i = 0; i < BENCH_ELEMENTS; i++)
+		{
+			c.push_back ((uint64_t) i);
+		}
+	});
+	t_map = bench_run<std::pmr::map<uint32_t, uint64_t>> (mr, [] (std::pmr::map<uint32_t, uint64_t> &c)
+	{
+		for (int i = 0; i < BENCH_ELEMENTS; i++)
+		{
+			c.emplace ((uint32_t) (i * 7 % BENCH_ELEMENTS), (uint64_t) i);
+		}
+	});
+	t_umap = bench_run<std::pmr::unordered_map<uint32_t, uint32_t>> (mr,
+			[] (std::pmr::unordered_map<uint32_t, uint32_t> &c)
+	{
+		c.reserve (BENCH_ELEMENTS);
+		for (int i = 0; i < BENCH_ELEMENTS; i++)
+		{
+			c.emplace ((uint32_t) i, (uint32_t) i);
+		}
+	});
+	std::printf ("%-20s %12.2f %12.2f %12.2f %14.2f\n", what, t_vec, t_list, t_map, t_umap);
+}
+
+int
+main ()
+{
+	std::printf ("%d elements x %d rounds, ns per round\n", BENCH_ELEMENTS, BENCH_ROUNDS);
+	std::printf ("%-20s %12s %12s %12s %14s\n", "", "vector", "list", "map", "unordered_map");
+	try
+	{
+		bench_resource ("mempool_resource", mempool_resource::instance ());
+	}
+	catch (const std::bad_alloc&)
+	{
+		std::printf ("mempool_resource exhausted\n");
+		return 1;
+	}
+	bench_resource ("new_delete_resource", std::pmr::new_delete_resource ());
+	return 0;
+}
@@ -10,6 +10,16 @@
 #include <stdio.h>
 #include <assert.h>
 #include <string.h>
+#if MEMP_HARDEN
+#include <time.h>
+#if defined(__linux__)
+#include <sys/random.h>
+#endif /* __linux__ */
+#if MEMP_HARDEN_GUARD
+#include <unistd.h>
+#include <sys/mman.h>
+#endif /* MEMP_HARDEN_GUARD */
+#endif /* MEMP_HARDEN */
 
 /* Get the number of entries in an array ('x' must NOT be a pointer!) */
 #define ARRAYSIZE(x) (sizeof(x)/sizeof((x)[0]))
@@ -118,7 +128,8 @@ memp_overflow_init_element (struct memp *p, const struct memp_desc *desc)
 static void
 memp_overflow_check_all(void)
 {
-	uint16_t i, j;
+	size_t i;
+	memp_count_t j;
 	struct memp *p;
 
 	for (i = 0; i < MEMP_MAX; ++i)
@@ -128,7 +139,7 @@ memp_overflow_check_all(void)
 		{
 			memp_overflow_check_element_overflow(p, memp_pools[i]);
 			//memp_overflow_check_element_underflow(p, memp_pools[i]);
-			p = ALIGNMENT_CAST(struct memp*, ((uint8_t*)p + MEMP_SIZE + memp_pools[i]->size));
+			p = ALIGNMENT_CAST(struct memp*, ((uint8_t*)p + MEMP_ELEMENT_STRIDE(memp_pools[i]->size)));
 		}
 	}
 }
@@ -136,6 +147,361 @@ memp_overflow_check_all(void)
 
 #endif
 
+#if MEMP_HARDEN
+/** Pattern freed elements are filled with when MEMP_HARDEN_POISON is on */
+#define MEMP_POISON 0xdb
+/** MEMP_POISON in every byte of a word */
+#define MEMP_POISON_WORD ((~(uintptr_t) 0 / 0xff) * MEMP_POISON)
+
+/**
+ * Report a hardening violation
+ * @param desc the pool it happened in
+ * @param what description of the violation
+ */
+static void
+memp_harden_violation (const struct memp_desc *desc, const char *what)
+{
+#if MEMP_LOG
+	printf("memp: %s in pool %s\n", what, desc->desc);
+#else
+	(void) what;
+#endif
+#if MEMP_STATS
+	MEMP_DESC_STATS(desc)->illegal++;
+#else
+	(void) desc;
+#endif
+	assert(0);
+}
+
+/**
+ * Get a random secret for the freelist of a pool
+ */
+static uintptr_t
+memp_harden_random (void)
+{
+	uintptr_t secret = 0;
+
+#if defined(__linux__)
+	if (getrandom (&secret, sizeof(secret), 0) == (ssize_t) sizeof(secret))
+	{
+		return secret;
+	}
+#endif /* __linux__ */
+	/* no entropy source: mix addresses and time, still better than a constant */
+	secret = (uintptr_t) &secret ^ ((uintptr_t) time (NULL) * (uintptr_t) 0x9e3779b97f4a7c15ULL)
+			^ (uintptr_t) clock ();
+	return secret;
+}
+
+/**
+ * Get the index of an element of a pool
+ *
+ * @param desc the pool
+ * @param p the pointer to check
+ * @return the index of the element p is the start of, desc->num if p is no element of desc
+ */
+static memp_count_t
+memp_harden_index (const struct memp_desc *desc, const void *p)
+{
+	uintptr_t start = (uintptr_t) MEM_ALIGN(desc->base);
+	uintptr_t stride = MEMP_ELEMENT_STRIDE(desc->size);
+	uintptr_t offset = (uintptr_t) p - start;
+
+	if ((uintptr_t) p < start || offset >= desc->num * stride || offset % stride != 0)
+	{
+		return desc->num;
+	}
+	return (memp_count_t) (offset / stride);
+}
+
+/**
+ * Check that a pointer is the start of an element of a pool
+ *
+ * @param desc the pool
+ * @param p the pointer to check
+ * @return 1 if p is an element of desc, 0 otherwise
+ */
+static int
+memp_harden_is_element (const struct memp_desc *desc, const void *p)
+{
+	return memp_harden_index (desc, p) != desc->num;
+}
+
+/**
+ * Encode (or decode) a freelist next pointer stored in element 'memp'
+ */
+#define MEMP_HARDEN_NEXT(desc, memp, next) \
+	((struct memp*) ((uintptr_t) (next) ^ (desc)->harden->secret ^ (uintptr_t) (memp)))
+
+/**
+ * Set the allocated bit of an element. The bitmap is shared with frontends
+ * running outside of the pool lock (memp_percpu), hence the atomics.
+ *
+ * @param desc the pool
+ * @param i index of the element
+ * @return 1 if the bit was set already, 0 otherwise
+ */
+static int
+memp_harden_set_allocated (const struct memp_desc *desc, memp_count_t i)
+{
+	uint8_t bit = (uint8_t) (1U << (i % 8U));
+
+	return (__atomic_fetch_or (&desc->harden->allocated[i / 8U], bit, __ATOMIC_RELAXED) & bit) != 0;
+}
+
+/**
+ * Clear the allocated bit of an element
+ *
+ * @param desc the pool
+ * @param i index of the element
+ * @return 1 if the bit was set, 0 otherwise
+ */
+static int
+memp_harden_clear_allocated (const struct memp_desc *desc, memp_count_t i)
+{
+	uint8_t bit = (uint8_t) (1U << (i % 8U));
+
+	return (__atomic_fetch_and (&desc->harden->allocated[i / 8U], (uint8_t) ~bit, __ATOMIC_RELAXED) & bit) != 0;
+}
+
+#if MEMP_HARDEN_POISON
+/**
+ * Check that nothing wrote into a free element
+ *
+ * @param desc the pool
+ * @param memp the free element
+ * @return 1 if the poison is intact, 0 otherwise
+ */
+static int
+memp_harden_check_poison (const struct memp_desc *desc, const struct memp *memp)
+{
+	const uint8_t *m = (const uint8_t*) memp + sizeof(struct memp);
+	const uint8_t *end = (const uint8_t*) memp + desc->size;
+	uintptr_t word;
+
+	/* a word at a time, the tail byte by byte */
+	for (; m + sizeof(word) <= end; m += sizeof(word))
+	{
+		memcpy (&word, m, sizeof(word));
+		if (word != MEMP_POISON_WORD)
+		{
+			return 0;
+		}
+	}
+	for (; m < end; m++)
+	{
+		if (*m != MEMP_POISON)
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+#endif /* MEMP_HARDEN_POISON */
+
+#if MEMP_HARDEN_QUARANTINE > 0
+/**
+ * Put an element in quarantine
+ *
+ * @param desc the pool
+ * @param memp the element freed
+ * @return the oldest quarantined element, evicted to make room, or NULL
+ */
+static struct memp *
+memp_harden_quarantine_put (const struct memp_desc *desc, struct memp *memp)
+{
+	struct memp_harden *harden = desc->harden;
+	struct memp *evicted = NULL;
+
+	if (harden->count == MEMP_HARDEN_QUARANTINE)
+	{
+		evicted = harden->quarantine[harden->head];
+		harden->head = (harden->head + 1) % MEMP_HARDEN_QUARANTINE;
+		harden->count--;
+	}
+	harden->quarantine[(harden->head + harden->count) % MEMP_HARDEN_QUARANTINE] = memp;
+	harden->count++;
+
+	return evicted;
+}
+
+/**
+ * Take the oldest element out of quarantine
+ * @param desc the pool
+ * @return the element or NULL if the quarantine is empty
+ */
+static struct memp *
+memp_harden_quarantine_get (const struct memp_desc *desc)
+{
+	struct memp_harden *harden = desc->harden;
+	struct memp *memp;
+
+	if (harden->count == 0)
+	{
+		return NULL;
+	}
+	memp = harden->quarantine[harden->head];
+	harden->head = (harden->head + 1) % MEMP_HARDEN_QUARANTINE;
+	harden->count--;
+
+	return memp;
+}
+#endif /* MEMP_HARDEN_QUARANTINE > 0 */
+
+/**
+ * Pop the first valid element of the freelist (or the oldest quarantined one
+ * when the freelist is empty). A corrupted next pointer cuts the freelist,
+ * an element written after free is never handed out again.
+ *
+ * @param desc the pool
+ * @return the element or NULL if the pool is empty
+ */
+static struct memp *
+memp_harden_pop (const struct memp_desc *desc)
+{
+	struct memp *memp;
+	struct memp *next;
+
+	for (;;)
+	{
+		memp = *desc->tab;
+		if (memp != NULL)
+		{
+			next = MEMP_HARDEN_NEXT(desc, memp, memp->next);
+			if (next != NULL && !memp_harden_is_element (desc, next))
+			{
+				memp_harden_violation (desc, "corrupted freelist");
+				next = NULL;
+			}
+			*desc->tab = next;
+		}
+#if MEMP_HARDEN_QUARANTINE > 0
+		else
+		{
+			memp = memp_harden_quarantine_get (desc);
+		}
+#endif /* MEMP_HARDEN_QUARANTINE > 0 */
+		if (memp == NULL)
+		{
+			return NULL;
+		}
+#if MEMP_HARDEN_POISON
+		if (!memp_harden_check_poison (desc, memp))
+		{
+			memp_harden_violation (desc, "write after free");
+			continue;
+		}
+#endif /* MEMP_HARDEN_POISON */
+		if (memp_harden_set_allocated (desc, memp_harden_index (desc, memp)))
+		{
+			/* a forged next pointer to a live element */
+			memp_harden_violation (desc, "allocated element on the freelist");
+			continue;
+		}
+		return memp;
+	}
+}
+
+#if MEMP_HARDEN_GUARD
+/**
+ * Make the guard page behind an element inaccessible
+ *
+ * @param desc the pool
+ * @param memp the element, at the start of its pages
+ */
+static void
+memp_harden_guard (const struct memp_desc *desc, struct memp *memp)
+{
+	int ret;
+
+	assert((size_t) sysconf (_SC_PAGESIZE) <= MEMP_HARDEN_GUARD_PAGE_SIZE
+			&& MEMP_HARDEN_GUARD_PAGE_SIZE % (size_t) sysconf (_SC_PAGESIZE) == 0);
+	ret = mprotect ((uint8_t*) memp + MEMP_HARDEN_GUARD_ROUND(MEMP_SIZE + desc->size), MEMP_HARDEN_GUARD_PAGE_SIZE,
+			PROT_NONE);
+	assert(ret == 0);
+	(void) ret;
+}
+#endif /* MEMP_HARDEN_GUARD */
+
+/**
+ * Check an element about to be freed and mark it free
+ *
+ * @param desc the pool
+ * @param mem the element
+ * @return 1 if mem may be freed, 0 otherwise
+ */
+int
+memp_harden_check_free (const struct memp_desc *desc, const void *mem)
+{
+	memp_count_t i = memp_harden_index (desc, mem);
+
+	if (i == desc->num)
+	{
+		memp_harden_violation (desc, "free of a pointer not in the pool");
+		return 0;
+	}
+	if (!memp_harden_clear_allocated (desc, i))
+	{
+		memp_harden_violation (desc, "double free");
+		return 0;
+	}
+	return 1;
+}
+
+/**
+ * Mark an element allocated again
+ *
+ * @param desc the pool
+ * @param mem the element
+ */
+void
+memp_harden_mark_allocated (const struct memp_desc *desc, const void *mem)
+{
+	memp_harden_set_allocated (desc, memp_harden_index (desc, mem));
+}
+
+/**
+ * Poison an element that was just freed
+ *
+ * @param desc the pool
+ * @param mem the element
+ */
+void
+memp_harden_poison (const struct memp_desc *desc, void *mem)
+{
+#if MEMP_HARDEN_POISON
+	memset ((uint8_t*) mem + sizeof(struct memp), MEMP_POISON, desc->size - sizeof(struct memp));
+#else
+	(void) desc;
+	(void) mem;
+#endif /* MEMP_HARDEN_POISON */
+}
+
+/**
+ * Check the poison of a free element before handing it out again
+ *
+ * @param desc the pool
+ * @param mem the element
+ * @return 1 if mem may be handed out, 0 otherwise
+ */
+int
+memp_harden_check_reuse (const struct memp_desc *desc, const void *mem)
+{
+#if MEMP_HARDEN_POISON
+	if (!memp_harden_check_poison (desc, (const struct memp*) mem))
+	{
+		memp_harden_violation (desc, "write after free");
+		return 0;
+	}
+#else
+	(void) desc;
+	(void) mem;
+#endif /* MEMP_HARDEN_POISON */
+	return 1;
+}
+#endif /* MEMP_HARDEN */
+
 /**
  * Private, free memory pool
  * @param desc
@@ -149,16 +515,38 @@ do_memp_free_pool (const struct memp_desc* desc, void *mem)
 	/* cast through void* to get rid of alignment warnings */
 	memp = (struct memp *) (void *) ((uint8_t*) mem);
 
+#if MEMP_HARDEN
+	if (!memp_harden_check_free (desc, memp))
+	{
+		return;
+	}
+#endif /* MEMP_HARDEN */
+
 #if MEMP_OVERFLOW_CHECK == 1
 	memp_overflow_check_element_overflow (memp, desc);
 	//memp_overflow_check_element_underflow(memp, desc);
 #endif /* MEMP_OVERFLOW_CHECK */
 
 #if MEMP_STATS
-	desc->stats->used--;
+	MEMP_DESC_STATS(desc)->used--;
+	MEMP_DESC_STATS(desc)->frees++;
 #endif
 
+#if MEMP_HARDEN
+#if MEMP_HARDEN_POISON
+	memset ((uint8_t*) memp + sizeof(struct memp), MEMP_POISON, desc->size - sizeof(struct memp));
+#endif /* MEMP_HARDEN_POISON */
+#if MEMP_HARDEN_QUARANTINE > 0
+	memp = memp_harden_quarantine_put (desc, memp);
+	if (memp == NULL)
+	{
+		return;
+	}
+#endif /* MEMP_HARDEN_QUARANTINE > 0 */
+	memp->next = MEMP_HARDEN_NEXT(desc, memp, *desc->tab);
+#else
 	memp->next = *desc->tab;
+#endif /* MEMP_HARDEN */
 	*desc->tab = memp;
 
 }
@@ -179,7 +567,11 @@ do_memp_malloc_pool_fn (const struct memp_desc *desc, const char* file, const in
 {
 	struct memp *memp;
 
+#if MEMP_HARDEN
+	memp = memp_harden_pop (desc);
+#else
 	memp = *desc->tab;
+#endif /* MEMP_HARDEN */
 
 	if (memp != NULL)
 	{
@@ -188,7 +580,9 @@ do_memp_malloc_pool_fn (const struct memp_desc *desc, const char* file, const in
 		//memp_overflow_check_element_underflow(memp, desc);
 #endif /* MEMP_OVERFLOW_CHECK */
 
+#if !MEMP_HARDEN
 		*desc->tab = memp->next;
+#endif /* !MEMP_HARDEN */
 #if MEMP_OVERFLOW_CHECK
 		memp->next = NULL;
 #endif /* MEMP_OVERFLOW_CHECK */
@@ -199,10 +593,11 @@ do_memp_malloc_pool_fn (const struct memp_desc *desc, const char* file, const in
 #endif /* MEMP_OVERFLOW_CHECK */
 
 #if MEMP_STATS
-		desc->stats->used++;
-		if (desc->stats->used > desc->stats->max)
+		MEMP_DESC_STATS(desc)->allocs++;
+		MEMP_DESC_STATS(desc)->used++;
+		if (MEMP_DESC_STATS(desc)->used > MEMP_DESC_STATS(desc)->max)
 		{
-			desc->stats->max = desc->stats->used;
+			MEMP_DESC_STATS(desc)->max = MEMP_DESC_STATS(desc)->used;
 		}
 #endif
 		/* cast through u8_t* to get rid of alignment warnings */
@@ -214,7 +609,7 @@ do_memp_malloc_pool_fn (const struct memp_desc *desc, const char* file, const in
 		printf("memp_malloc: out of memory in pool %s\n", desc->desc);
 #endif
 #if MEMP_STATS
-		desc->stats->err++;
+		MEMP_DESC_STATS(desc)->err++;
 #endif
 	}
 	return NULL;
@@ -227,32 +622,47 @@ do_memp_malloc_pool_fn (const struct memp_desc *desc, const char* file, const in
 void
 memp_init_pool (const struct memp_desc *desc)
 {
-	int i;
+	memp_count_t i;
 	struct memp *memp;
+#if MEMP_HARDEN
+	uint8_t *allocated = desc->harden->allocated;
+#endif /* MEMP_HARDEN */
 
 	*desc->tab = NULL;
+#if MEMP_HARDEN
+	memset (desc->harden, 0, sizeof(*desc->harden));
+	desc->harden->allocated = allocated;
+	memset (allocated, 0, (desc->num + 7U) / 8U);
+	desc->harden->secret = memp_harden_random ();
+#endif /* MEMP_HARDEN */
 	memp = (struct memp*) MEM_ALIGN(desc->base);
 	/* create a linked list of memp elements */
 	for (i = 0; i < desc->num; ++i)
 	{
+#if MEMP_HARDEN
+#if MEMP_HARDEN_POISON
+		memset ((uint8_t*) memp + sizeof(struct memp), MEMP_POISON, desc->size - sizeof(struct memp));
+#endif /* MEMP_HARDEN_POISON */
+		memp->next = MEMP_HARDEN_NEXT(desc, memp, *desc->tab);
+#else
 		memp->next = *desc->tab;
+#endif /* MEMP_HARDEN */
 		*desc->tab = memp;
 #if MEMP_OVERFLOW_CHECK
 		memp_overflow_init_element (memp, desc);
 #endif /* MEMP_OVERFLOW_CHECK */
+#if MEMP_HARDEN && MEMP_HARDEN_GUARD
+		memp_harden_guard (desc, memp);
+#endif /* MEMP_HARDEN && MEMP_HARDEN_GUARD */
 		/* cast through void* to get rid of alignment warnings */
-		memp = (struct memp *) (void *) ((uint8_t *) memp + desc->size
-#if MEMP_OVERFLOW_CHECK
-				+ MEMP_SANITY_REGION_AFTER_ALIGNED
-#endif
-				);
+		memp = (struct memp *) (void *) ((uint8_t *) memp + MEMP_ELEMENT_STRIDE(desc->size));
 	}
 #if MEMP_STATS
-	desc->stats->avail = desc->num;
+	MEMP_DESC_STATS(desc)->avail = desc->num;
 #endif /* MEMP_STATS */
 
 #if MEMP_STATS
-	desc->stats->name = desc->desc;
+	MEMP_DESC_STATS(desc)->name = desc->desc;
 #endif /* MEMP_STATS*/
 }
 
@@ -263,7 +673,7 @@ memp_init_pool (const struct memp_desc *desc)
 void
 memp_init (void)
 {
-	uint16_t i;
+	size_t i;
 
 	/* for every pool: */
 	for (i = 0; i < ARRAYSIZE(memp_pools); i++)
@@ -328,3 +738,41 @@ memp_free (memp_t type, void *mem)
 
 }
 
+
+/**
+ * Get an element from a custom pool (not listed in pools.h)
+ *
+ * @param desc the pool to get an element from
+ *
+ * @return a pointer to the allocated memory or a NULL pointer on error
+ */
+void *
+#if !MEMP_OVERFLOW_CHECK
+memp_malloc_pool (const struct memp_desc *desc)
+#else
+memp_malloc_pool_fn (const struct memp_desc *desc, const char* file, const int line)
+#endif
+{
+#if !MEMP_OVERFLOW_CHECK
+	return do_memp_malloc_pool (desc);
+#else
+	return do_memp_malloc_pool_fn (desc, file, line);
+#endif
+}
+
+/**
+ * Put an element back into a custom pool (not listed in pools.h)
+ *
+ * @param desc the pool where to put mem
+ * @param mem the memp element to free
+ */
+void
+memp_free_pool (const struct memp_desc *desc, void *mem)
+{
+	if (mem == NULL)
+	{
+		return;
+	}
+
+	do_memp_free_pool (desc, mem);
+}
@@ -11,6 +11,10 @@
 #include <stdint.h>
 #include <stddef.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /* run once with empty definition to handle all custom includes in pools.h */
 #define MEMPOOL(name,num,size,desc)
 #include "pools.h"
@@ -28,10 +32,120 @@ extern const struct memp_desc* const memp_pools[MEMP_MAX];
 /**
  * Set to memory alignment supported by your platform
  */
+#ifndef MEM_ALIGNMENT
 #define MEM_ALIGNMENT                   1
+#endif
+#ifndef MEMP_OVERFLOW_CHECK
 #define MEMP_OVERFLOW_CHECK 2
+#endif
+#ifndef MEMP_LOG
 #define MEMP_LOG		0
+#endif
+#ifndef MEMP_STATS
 #define MEMP_STATS	1
+#endif
+
+/**
+ * Set to 1 to collect, for every malloc pool, a histogram of the requested
+ * sizes, the number of requests spilled into a bigger pool and the bytes
+ * lost to internal fragmentation by live elements (requires MEMP_STATS)
+ */
+#ifndef MEMP_STATS_MALLOC
+#define MEMP_STATS_MALLOC	1
+#endif
+/** Histogram buckets, bucket n counts requests of n/BUCKETS..(n+1)/BUCKETS of the element */
+#ifndef MEMP_STATS_HIST_BUCKETS
+#define MEMP_STATS_HIST_BUCKETS	8
+#endif
+
+/**
+ * Set to 1 to allow publishing the pool statistics into a shared memory
+ * segment read by the mempstat tool, see memp_shm.h (requires MEMP_STATS)
+ */
+#ifndef MEMP_STATS_SHM
+#define MEMP_STATS_SHM	1
+#endif
+
+/**
+ * Set to 1 to use 64-bit element counters and statistics (32-bit otherwise,
+ * element counts are 16-bit then). Required for pools
+ * with more than 65535 elements (MEMPOOL_DECLARE fails to compile otherwise)
+ * or pool extents above 4GB.
+ * Pool extents above 2GB also need a large enough code model
+ * (e.g. -mcmodel=medium with gcc on x86-64).
+ */
+#ifndef MEMP_LARGE_POOLS
+#define MEMP_LARGE_POOLS	1
+#endif
+
+/**
+ * Set to 1 to pack struct memp_malloc_helper into 8-bit pool number and
+ * 16-bit size. Only valid when there are less than 256 pools and no malloc pool
+ * is bigger than 65535 bytes, both checked at compile time.
+ */
+#ifndef MEMP_COMPACT_HELPER
+#define MEMP_COMPACT_HELPER	0
+#endif
+
+/**
+ * Set to 1 to harden the pools against use-after-free and double free:
+ * freelist next pointers are encoded with a per-pool secret, freed pointers
+ * have to lie on an element boundary inside their pool and every pool keeps
+ * a bitmap of its allocated elements, so freeing an element that is not
+ * allocated is rejected.
+ * Violations are counted in stats->illegal and asserted. Off by default,
+ * see bench_harden.c for the cost of every option.
+ */
+#ifndef MEMP_HARDEN
+#define MEMP_HARDEN	0
+#endif
+
+/**
+ * Set to 1 (with MEMP_HARDEN) to fill freed elements with 0xdb and verify
+ * the pattern on allocation. Costs a memset and a scan of the element.
+ */
+#ifndef MEMP_HARDEN_POISON
+#define MEMP_HARDEN_POISON	0
+#endif
+
+/**
+ * Number of freed elements of each pool held back (FIFO) before they go
+ * back to the freelist, delaying their reuse. 0 disables the quarantine.
+ * Quarantined elements are still handed out when the freelist is empty.
+ */
+#ifndef MEMP_HARDEN_QUARANTINE
+#define MEMP_HARDEN_QUARANTINE	0
+#endif
+
+/**
+ * Set to 1 (with MEMP_HARDEN) to give every element its own pages followed
+ * by an inaccessible guard page (mprotect): an overflow past the last page of
+ * an element, or an underflow into the guard page of the one before, faults
+ * at once. Costs at least two pages per element.
+ */
+#ifndef MEMP_HARDEN_GUARD
+#define MEMP_HARDEN_GUARD	0
+#endif
+
+/** Page size of the guard layout, a multiple of the system page size */
+#ifndef MEMP_HARDEN_GUARD_PAGE_SIZE
+#define MEMP_HARDEN_GUARD_PAGE_SIZE	4096
+#endif
+
+#if MEMP_LARGE_POOLS
+typedef uint64_t memp_count_t;
+typedef uint64_t memp_stats_t;
+#else
+typedef uint16_t memp_count_t;
+/* statistics count events, not elements: keep them at least 32-bit */
+typedef uint32_t memp_stats_t;
+#endif /* MEMP_LARGE_POOLS */
+
+#ifdef __cplusplus
+#define MEMP_STATIC_ASSERT(cond, msg) static_assert(cond, msg)
+#else
+#define MEMP_STATIC_ASSERT(cond, msg) _Static_assert(cond, msg)
+#endif
 
 #ifndef MEM_ALIGN_BUFFER
 #define MEM_ALIGN_BUFFER(size) (((size) + MEM_ALIGNMENT - 1U))
@@ -48,7 +162,13 @@ extern const struct memp_desc* const memp_pools[MEMP_MAX];
 
 #define MEM_ALIGN(addr) ((void *)(((uintptr_t)(addr) + MEM_ALIGNMENT - 1) & ~(uintptr_t)(MEM_ALIGNMENT-1)))
 
+#if MEMP_HARDEN && MEMP_HARDEN_GUARD
+/* guard pages can only be protected in page aligned storage */
+#define DECLARE_MEMORY_ALIGNED(variable_name, size) \
+  uint8_t variable_name[size] __attribute__((aligned(MEMP_HARDEN_GUARD_PAGE_SIZE)))
+#else
 #define DECLARE_MEMORY_ALIGNED(variable_name, size) uint8_t variable_name[MEM_ALIGN_BUFFER(size)]
+#endif /* MEMP_HARDEN && MEMP_HARDEN_GUARD */
 
 #if MEMP_OVERFLOW_CHECK
 /** if MEMP_OVERFLOW_CHECK is turned on, we reserve some bytes TODO:(at the beginning
@@ -90,16 +210,41 @@ extern const struct memp_desc* const memp_pools[MEMP_MAX];
 
 #endif
 
+/** Bytes from one element of a pool of element size 'size' to the next */
+#if MEMP_HARDEN && MEMP_HARDEN_GUARD
+#define MEMP_HARDEN_GUARD_ROUND(x) \
+  (((x) + MEMP_HARDEN_GUARD_PAGE_SIZE - 1U) & ~(size_t) (MEMP_HARDEN_GUARD_PAGE_SIZE - 1U))
+#define MEMP_ELEMENT_STRIDE(size) (MEMP_HARDEN_GUARD_ROUND(MEMP_SIZE + (size)) + MEMP_HARDEN_GUARD_PAGE_SIZE)
+#else
+#define MEMP_ELEMENT_STRIDE(size) (MEMP_SIZE + (size))
+#endif /* MEMP_HARDEN && MEMP_HARDEN_GUARD */
 
 
-#if MEMP_STATS
+
+#if MEMP_STATS && MEMP_STATS_SHM
+#define MEMPOOL_DECLARE_STATS_INSTANCE(name) static struct stats_mem name; \
+  static struct stats_mem *name ## _ptr = &name;
+#define MEMPOOL_DECLARE_STATS_REFERENCE(name) &name ## _ptr,
+/** Statistics of a pool */
+#define MEMP_DESC_STATS(desc) (*(desc)->stats)
+#elif MEMP_STATS
 #define MEMPOOL_DECLARE_STATS_INSTANCE(name) static struct stats_mem name;
 #define MEMPOOL_DECLARE_STATS_REFERENCE(name) &name,
+#define MEMP_DESC_STATS(desc) ((desc)->stats)
 #else
 #define MEMPOOL_DECLARE_STATS_INSTANCE(name)
 #define MEMPOOL_DECLARE_STATS_REFERENCE(name)
 #endif
 
+#if MEMP_HARDEN
+#define MEMPOOL_DECLARE_HARDEN_INSTANCE(name, num) static uint8_t name ## _allocated[((num) + 7U) / 8U]; \
+  static struct memp_harden name = { .allocated = name ## _allocated };
+#define MEMPOOL_DECLARE_HARDEN_REFERENCE(name) , &name
+#else
+#define MEMPOOL_DECLARE_HARDEN_INSTANCE(name, num)
+#define MEMPOOL_DECLARE_HARDEN_REFERENCE(name)
+#endif
+
 #if MEMP_LOG || MEMP_OVERFLOW_CHECK || MEMP_STATS
 #define DECLARE_MEMPOOL_DESC(desc) (desc),
 #else
@@ -136,11 +281,23 @@ struct stats_mem {
 #if MEMP_STATS
   const char *name;
 #endif /* MEMP_STATS*/
-  uint32_t err;
-  uint32_t avail;
-  uint32_t used;
-  uint32_t max;
-  uint32_t illegal;
+  memp_stats_t err;
+  memp_stats_t avail;
+  memp_stats_t used;
+  memp_stats_t max;
+  memp_stats_t illegal;
+  /** Allocations since init, never decremented */
+  memp_stats_t allocs;
+  /** Releases since init, never decremented */
+  memp_stats_t frees;
+#if MEMP_STATS_MALLOC
+  /** Requests fitting this pool served by a bigger one because it was empty */
+  memp_stats_t spill;
+  /** Element bytes not covered by the requests of live elements */
+  memp_stats_t frag_bytes;
+  /** Requests served by this pool, by share of the element they use */
+  memp_stats_t hist[MEMP_STATS_HIST_BUCKETS];
+#endif /* MEMP_STATS_MALLOC */
 };
 
 struct memp {
@@ -151,14 +308,36 @@ struct memp {
 #endif /* MEMP_OVERFLOW_CHECK */
 };
 
+#if MEMP_HARDEN
+/** Hardened mode state of one pool */
+struct memp_harden {
+  /** One bit per element, set while it is allocated (index = offset / stride) */
+  uint8_t *allocated;
+  /** Secret the freelist next pointers are encoded with */
+  uintptr_t secret;
+#if MEMP_HARDEN_QUARANTINE > 0
+  /** Recently freed elements, not yet on the freelist */
+  struct memp *quarantine[MEMP_HARDEN_QUARANTINE];
+  /** Index of the oldest quarantined element */
+  memp_count_t head;
+  /** Number of quarantined elements */
+  memp_count_t count;
+#endif /* MEMP_HARDEN_QUARANTINE > 0 */
+};
+#endif /* MEMP_HARDEN */
+
 /** Memory pool descriptor */
 struct memp_desc {
 #if MEMP_OVERFLOW_CHECK || MEMP_LOG || MEMP_STATS
   /** Textual description */
   const char *desc;
 #endif /* MEMP_OVERFLOW_CHECK || MEM_LOG */
-#if MEMP_STATS
-  /** Statistics */
+#if MEMP_STATS && MEMP_STATS_SHM
+  /** Statistics, use MEMP_DESC_STATS. Like tab, this points to a pointer
+   * so the statistics can be moved into the shared stats segment (see memp_shm.h) */
+  struct stats_mem **stats;
+#elif MEMP_STATS
+  /** Statistics, use MEMP_DESC_STATS */
   struct stats_mem *stats;
 #endif
 
@@ -167,13 +346,18 @@ struct memp_desc {
 
 #if !MEMP_MEM_MALLOC
   /** Number of elements */
-  uint16_t num;
+  memp_count_t num;
 
   /** Base address */
   uint8_t *base;
 
   /** First free element of each pool. Elements form a linked list. */
   struct memp **tab;
+
+#if MEMP_HARDEN
+  /** Hardened mode state */
+  struct memp_harden *harden;
+#endif /* MEMP_HARDEN */
 #endif /* MEMP_MEM_MALLOC */
 };
 
@@ -181,27 +365,51 @@ struct memp_desc {
  * This has to be defined here as it is required for pool size calculation. */
 struct memp_malloc_helper
 {
+#if MEMP_COMPACT_HELPER
+   uint8_t poolnr;
+#else
    memp_t poolnr;
-#if MEMP_OVERFLOW_CHECK || MEM_STATS
+#endif /* MEMP_COMPACT_HELPER */
+#if MEMP_OVERFLOW_CHECK || MEMP_STATS_MALLOC
+#if MEMP_COMPACT_HELPER
+   uint16_t size;
+#else
    size_t size;
-#endif /* MEMP_OVERFLOW_CHECK || MEM_STATS */
+#endif /* MEMP_COMPACT_HELPER */
+#endif /* MEMP_OVERFLOW_CHECK || MEMP_STATS_MALLOC */
 };
 
+#if MEMP_COMPACT_HELPER
+/* the helper keeps MEMP_MAX as pool number of large objects and the request size in 16 bits */
+MEMP_STATIC_ASSERT(MEMP_MAX <= 0xff, "MEMP_COMPACT_HELPER needs less than 256 pools");
+#define MEMPOOL(name,num,size,desc)
+#define MALLOC_MEMPOOL_START
+#define MALLOC_MEMPOOL(num, size) \
+  MEMP_STATIC_ASSERT((size) <= 0xffff, "MALLOC_MEMPOOL(" #num ", " #size ") is too big for MEMP_COMPACT_HELPER");
+#define MALLOC_MEMPOOL_END
+#include "pools.h"
+#endif /* MEMP_COMPACT_HELPER */
+
 
 #define MEMPOOL_DECLARE(name,num,size,desc) \
-  DECLARE_MEMORY_ALIGNED(memp_memory_ ## name ## _base, ((num) * (MEMP_SIZE + MEMP_ALIGN_SIZE(size)))); \
+  MEMP_STATIC_ASSERT((uint64_t)(num) <= (memp_count_t)~(memp_count_t)0, \
+      desc " has more elements than memp_count_t holds, see MEMP_LARGE_POOLS"); \
+  DECLARE_MEMORY_ALIGNED(memp_memory_ ## name ## _base, ((memp_count_t)(num) * MEMP_ELEMENT_STRIDE(MEMP_ALIGN_SIZE(size)))); \
     \
   MEMPOOL_DECLARE_STATS_INSTANCE(memp_stats_ ## name) \
     \
   static struct memp *memp_tab_ ## name; \
     \
+  MEMPOOL_DECLARE_HARDEN_INSTANCE(memp_harden_ ## name, num) \
+    \
   const struct memp_desc memp_ ## name = { \
     DECLARE_MEMPOOL_DESC(desc) \
     MEMPOOL_DECLARE_STATS_REFERENCE(memp_stats_ ## name) \
 	MEMP_ALIGN_SIZE(size), \
-    (num), \
+    (memp_count_t)(num), \
     memp_memory_ ## name ## _base, \
     &memp_tab_ ## name \
+    MEMPOOL_DECLARE_HARDEN_REFERENCE(memp_harden_ ## name) \
   };
 
 /**
@@ -235,6 +443,67 @@ void *memp_malloc(memp_t type);
  */
 void  memp_free(memp_t type, void *mem);
 
+/**
+ * Allocate an element from a pool not listed in pools.h
+ * (e.g. ObjectPool in object_pool.hpp)
+ * @param desc
+ * @param file
+ * @param line
+ */
+#if MEMP_OVERFLOW_CHECK
+void *memp_malloc_pool_fn(const struct memp_desc *desc, const char* file, const int line);
+#define memp_malloc_pool(d) memp_malloc_pool_fn((d), __FILE__, __LINE__)
+#else
+void *memp_malloc_pool(const struct memp_desc *desc);
+#endif
+
+/**
+ * Put an element back into a pool not listed in pools.h
+ * @param desc
+ * @param mem
+ */
+void  memp_free_pool(const struct memp_desc *desc, void *mem);
+
+#if MEMP_HARDEN
+/**
+ * Check an element about to be freed without going through memp_free
+ * (for frontends caching free elements, e.g. memp_percpu): it has to be
+ * the start of an allocated element of desc. It is marked free then.
+ * Violations are reported like in memp_free.
+ * @param desc
+ * @param mem
+ * @return 1 if mem may be freed, 0 otherwise
+ */
+int   memp_harden_check_free(const struct memp_desc *desc, const void *mem);
+
+/**
+ * Mark an element taken from such a cache allocated again, before it is
+ * handed out or given to memp_free
+ * @param desc
+ * @param mem
+ */
+void  memp_harden_mark_allocated(const struct memp_desc *desc, const void *mem);
 
+/**
+ * Poison an element that was just freed (nothing without MEMP_HARDEN_POISON)
+ * @param desc
+ * @param mem
+ */
+void  memp_harden_poison(const struct memp_desc *desc, void *mem);
+
+/**
+ * Check the poison of a free element before handing it out again,
+ * a violation is reported if something wrote into it
+ * @param desc
+ * @param mem
+ * @return 1 if mem may be handed out, 0 otherwise
+ */
+int   memp_harden_check_reuse(const struct memp_desc *desc, const void *mem);
+#endif /* MEMP_HARDEN */
+
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif /* MEMP_H_ */
@@ -0,0 +1,378 @@
+/*
+ * memp_percpu.c
+ *
+ *  Created on: Oct 19, 2026
+ */
+#include "memp_percpu.h"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#if defined(__linux__) && defined(__x86_64__) && defined(__GNUC__)
+#include <unistd.h>
+#include <sys/rseq.h>
+#include <sys/syscall.h>
+#include <linux/membarrier.h>
+#define MEMP_PERCPU_RSEQ 1
+#else
+#define MEMP_PERCPU_RSEQ 0
+#endif
+
+/** Cached elements of one CPU, one cache line apart from the other CPUs */
+struct memp_percpu {
+  /** Set while the elements of this CPU are taken away, the critical sections back off */
+  uintptr_t lock;
+  /** Number of elements in slot[type] */
+  uintptr_t count[MEMP_MAX];
+  /** Cached elements, slot[type][count[type] - 1] is handed out first */
+  void *slot[MEMP_MAX][MEMP_PERCPU_BATCH];
+} __attribute__((aligned(64)));
+
+static struct memp_percpu memp_percpu_tab[MEMP_PERCPU_MAX_CPUS];
+
+/** Protects the shared pools and serializes taking elements away from the CPUs */
+static pthread_mutex_t memp_percpu_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#if MEMP_PERCPU_RSEQ
+
+/** Per-CPU caching is used only if the elements of a CPU can be taken back (membarrier) */
+static int memp_percpu_enabled;
+/** Number of CPUs that may have cached elements */
+static int memp_percpu_ncpus;
+static pthread_once_t memp_percpu_once = PTHREAD_ONCE_INIT;
+
+/* Critical section descriptor, abort handler preceded by the rseq signature
+ * and commit label. Numbered labels: 1 start, 2 post commit, 3 descriptor, 4 abort */
+#define MEMP_RSEQ_CS_BEGIN \
+	".pushsection __rseq_cs, \"aw\"\n\t" \
+	".balign 32\n\t" \
+	"3:\n\t" \
+	".long 0x0, 0x0\n\t" \
+	".quad 1f, (2f - 1f), 4f\n\t" \
+	".popsection\n\t" \
+	"1:\n\t" \
+	"leaq 3b(%%rip), %%rax\n\t" \
+	"movq %%rax, %%fs:%c[cs_off](%[rseq_offset])\n\t" \
+	"cmpl %[cpu], %%fs:%c[cpu_off](%[rseq_offset])\n\t" \
+	"jnz 4f\n\t"
+
+#define MEMP_RSEQ_CS_END \
+	"2:\n\t" \
+	".pushsection __rseq_failure, \"ax\"\n\t" \
+	".byte 0x0f, 0xb9, 0x3d\n\t" \
+	".long " MEMP_RSEQ_STR(RSEQ_SIG) "\n\t" \
+	"4:\n\t" \
+	"jmp %l[abort]\n\t" \
+	".popsection\n\t"
+
+#define MEMP_RSEQ_STR_(x) #x
+#define MEMP_RSEQ_STR(x) MEMP_RSEQ_STR_(x)
+
+/**
+ * Enable per-CPU caching if rseq is registered and the elements
+ * of a CPU can be taken back with a membarrier rseq fence
+ */
+static void
+memp_percpu_init (void)
+{
+	long ncpus;
+
+	if (__rseq_size == 0
+			|| syscall (__NR_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED_RSEQ, 0, 0) != 0)
+	{
+		return;
+	}
+	ncpus = sysconf (_SC_NPROCESSORS_CONF);
+	memp_percpu_ncpus = ncpus > 0 && ncpus < MEMP_PERCPU_MAX_CPUS ? (int) ncpus : MEMP_PERCPU_MAX_CPUS;
+	memp_percpu_enabled = 1;
+}
+
+/**
+ * Get the CPU the calling thread runs on, as seen by rseq
+ * @return the CPU number or -1 if per-CPU caching is not possible
+ */
+static inline int
+memp_percpu_cpu (void)
+{
+	const volatile struct rseq *rs;
+	int cpu;
+
+	pthread_once (&memp_percpu_once, memp_percpu_init);
+	if (!memp_percpu_enabled)
+	{
+		return -1;
+	}
+	rs = (const volatile struct rseq*) (void*) ((uint8_t*) __builtin_thread_pointer () + __rseq_offset);
+	cpu = (int) (int32_t) rs->cpu_id_start;
+	return cpu < memp_percpu_ncpus ? cpu : -1;
+}
+
+/**
+ * Pop the last cached element of a CPU
+ *
+ * @param pc the cache of 'cpu'
+ * @param cpu the CPU the cache belongs to
+ * @param type the pool
+ * @param memp set to the element popped
+ * @return 0 on success, 1 if there is none or the cache is locked, -1 if the sequence aborted
+ */
+static inline int
+memp_percpu_pop (struct memp_percpu *pc, int cpu, memp_t type, void **memp)
+{
+	__asm__ __volatile__ goto (
+		MEMP_RSEQ_CS_BEGIN
+		"cmpq $0, %[lock]\n\t"
+		"jnz %l[busy]\n\t"
+		"movq %[count], %%rax\n\t"
+		"testq %%rax, %%rax\n\t"
+		"jz %l[busy]\n\t"
+		"movq -8(%[slot], %%rax, 8), %%rbx\n\t"
+		"movq %%rbx, %[memp]\n\t"
+		"subq $1, %%rax\n\t"
+		/* commit */
+		"movq %%rax, %[count]\n\t"
+		MEMP_RSEQ_CS_END
+		: /* gcc asm goto does not allow outputs */
+		: [cpu] "r" (cpu),
+		  [rseq_offset] "r" (__rseq_offset),
+		  [cs_off] "i" (offsetof(struct rseq, rseq_cs)),
+		  [cpu_off] "i" (offsetof(struct rseq, cpu_id)),
+		  [lock] "m" (pc->lock),
+		  [count] "m" (pc->count[type]),
+		  [slot] "r" (pc->slot[type]),
+		  [memp] "m" (*memp)
+		: "memory", "cc", "rax", "rbx"
+		: abort, busy);
+	return 0;
+busy:
+	return 1;
+abort:
+	return -1;
+}
+
+/**
+ * Push an element on the cache of a CPU, unless it holds MEMP_PERCPU_BATCH already
+ *
+ * @param pc the cache of 'cpu'
+ * @param cpu the CPU the cache belongs to
+ * @param type the pool
+ * @param memp the element
+ * @return 0 on success, 1 if the cache is full or locked, -1 if the sequence aborted
+ */
+static inline int
+memp_percpu_push (struct memp_percpu *pc, int cpu, memp_t type, void *memp)
+{
+	__asm__ __volatile__ goto (
+		MEMP_RSEQ_CS_BEGIN
+		"cmpq $0, %[lock]\n\t"
+		"jnz %l[busy]\n\t"
+		"movq %[count], %%rax\n\t"
+		"cmpq %[batch], %%rax\n\t"
+		"jae %l[busy]\n\t"
+		"movq %[memp], (%[slot], %%rax, 8)\n\t"
+		"addq $1, %%rax\n\t"
+		/* commit */
+		"movq %%rax, %[count]\n\t"
+		MEMP_RSEQ_CS_END
+		: /* gcc asm goto does not allow outputs */
+		: [cpu] "r" (cpu),
+		  [rseq_offset] "r" (__rseq_offset),
+		  [cs_off] "i" (offsetof(struct rseq, rseq_cs)),
+		  [cpu_off] "i" (offsetof(struct rseq, cpu_id)),
+		  [lock] "m" (pc->lock),
+		  [count] "m" (pc->count[type]),
+		  [batch] "i" (MEMP_PERCPU_BATCH),
+		  [slot] "r" (pc->slot[type]),
+		  [memp] "r" (memp)
+		: "memory", "cc", "rax"
+		: abort, busy);
+	return 0;
+busy:
+	return 1;
+abort:
+	return -1;
+}
+
+/**
+ * Give the cached elements of a CPU back to the shared pools, memp_percpu_lock held.
+ * The lock flag makes new critical sections on 'cpu' back off, the rseq fence
+ * restarts the ones already running there.
+ *
+ * @param cpu the CPU to take the elements of
+ * @param type the pool to take the elements of, MEMP_MAX for every pool
+ */
+static void
+memp_percpu_steal (int cpu, memp_t type)
+{
+	struct memp_percpu *pc = &memp_percpu_tab[cpu];
+	size_t i;
+
+	__atomic_store_n (&pc->lock, 1, __ATOMIC_SEQ_CST);
+	if (syscall (__NR_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED_RSEQ, MEMBARRIER_CMD_FLAG_CPU, cpu) == 0)
+	{
+		for (i = 0; i < MEMP_MAX; i++)
+		{
+			if (type != MEMP_MAX && i != (size_t) type)
+			{
+				continue;
+			}
+			while (pc->count[i] > 0)
+			{
+				pc->count[i]--;
+#if MEMP_HARDEN
+				/* marked free when it was cached, memp_free checks the mark again */
+				memp_harden_mark_allocated (memp_pools[i], pc->slot[i][pc->count[i]]);
+#endif /* MEMP_HARDEN */
+				memp_free ((memp_t) i, pc->slot[i][pc->count[i]]);
+			}
+		}
+	}
+	__atomic_store_n (&pc->lock, 0, __ATOMIC_RELEASE);
+}
+
+#endif /* MEMP_PERCPU_RSEQ */
+
+/**
+ * Get an element from the shared pool, taking the elements cached
+ * by the CPUs back first if it is empty
+ * @param type
+ */
+static void *
+memp_percpu_shared_malloc (memp_t type)
+{
+	void *memp;
+
+	pthread_mutex_lock (&memp_percpu_lock);
+#if MEMP_PERCPU_RSEQ
+	if (memp_percpu_enabled && *memp_pools[type]->tab == NULL)
+	{
+		int cpu;
+
+		for (cpu = 0; cpu < memp_percpu_ncpus && *memp_pools[type]->tab == NULL; cpu++)
+		{
+			if (__atomic_load_n (&memp_percpu_tab[cpu].count[type], __ATOMIC_RELAXED) > 0)
+			{
+				memp_percpu_steal (cpu, type);
+			}
+		}
+	}
+#endif /* MEMP_PERCPU_RSEQ */
+	memp = memp_malloc(type);
+	pthread_mutex_unlock (&memp_percpu_lock);
+
+	return memp;
+}
+
+/**
+ * Put an element back into the shared pool
+ * @param type
+ * @param mem
+ */
+static void
+memp_percpu_shared_free (memp_t type, void *mem)
+{
+	pthread_mutex_lock (&memp_percpu_lock);
+	memp_free (type, mem);
+	pthread_mutex_unlock (&memp_percpu_lock);
+}
+
+/**
+ * Get an element, from the cache of the current CPU if possible
+ *
+ * @param type the pool to get an element from
+ * @return a pointer to the allocated memory or NULL if the pool is empty
+ */
+void *
+memp_percpu_malloc (memp_t type)
+{
+#if MEMP_PERCPU_RSEQ
+	void *memp;
+	int cpu;
+
+	for (;;)
+	{
+		cpu = memp_percpu_cpu ();
+		if (cpu < 0 || memp_percpu_pop (&memp_percpu_tab[cpu], cpu, type, &memp) != 0)
+		{
+			break;
+		}
+#if MEMP_HARDEN
+		if (!memp_harden_check_reuse (memp_pools[type], memp))
+		{
+			/* written after free: never hand it out again */
+			continue;
+		}
+		memp_harden_mark_allocated (memp_pools[type], memp);
+#endif /* MEMP_HARDEN */
+		return memp;
+	}
+	/* empty or locked cache, aborted sequence or no rseq: use the shared pool */
+#endif /* MEMP_PERCPU_RSEQ */
+	return memp_percpu_shared_malloc (type);
+}
+
+/**
+ * Put an element on the cache of the current CPU, or back into
+ * the shared pool if that cache is full
+ *
+ * @param type the pool mem comes from
+ * @param mem the memp element to free
+ */
+void
+memp_percpu_free (memp_t type, void *mem)
+{
+	if (mem == NULL)
+	{
+		return;
+	}
+#if MEMP_HARDEN
+	if (!memp_harden_check_free (memp_pools[type], mem))
+	{
+		return;
+	}
+#endif /* MEMP_HARDEN */
+#if MEMP_PERCPU_RSEQ
+	{
+		int cpu;
+
+		cpu = memp_percpu_cpu ();
+#if MEMP_HARDEN
+		memp_harden_poison (memp_pools[type], mem);
+#endif /* MEMP_HARDEN */
+		if (cpu >= 0 && memp_percpu_push (&memp_percpu_tab[cpu], cpu, type, mem) == 0)
+		{
+			return;
+		}
+		/* full or locked cache, aborted sequence or no rseq: use the shared pool */
+	}
+#endif /* MEMP_PERCPU_RSEQ */
+#if MEMP_HARDEN
+	/* memp_free checks and clears the mark again */
+	memp_harden_mark_allocated (memp_pools[type], mem);
+#endif /* MEMP_HARDEN */
+	memp_percpu_shared_free (type, mem);
+}
+
+/**
+ * Give the elements cached by every CPU back to the shared pools
+ */
+void
+memp_percpu_drain (void)
+{
+#if MEMP_PERCPU_RSEQ
+	int cpu;
+
+	pthread_once (&memp_percpu_once, memp_percpu_init);
+	if (!memp_percpu_enabled)
+	{
+		return;
+	}
+	pthread_mutex_lock (&memp_percpu_lock);
+	for (cpu = 0; cpu < memp_percpu_ncpus; cpu++)
+	{
+		memp_percpu_steal (cpu, MEMP_MAX);
+	}
+	pthread_mutex_unlock (&memp_percpu_lock);
+#endif /* MEMP_PERCPU_RSEQ */
+}
@@ -0,0 +1,74 @@
+/*
+ * memp_percpu.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef MEMP_PERCPU_H_
+#define MEMP_PERCPU_H_
+
+#include "memp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Per-CPU pool frontend (Linux only).
+ *
+ * Every CPU caches up to MEMP_PERCPU_BATCH elements per memp_t, popped and
+ * pushed inside restartable sequences (rseq) instead of atomic
+ * read-modify-write. Frees to a full cache, allocations from an empty one,
+ * aborted sequences and threads without rseq fall back to the shared pool,
+ * which is then protected by a lock: once this frontend is used, every
+ * memp_malloc/memp_free of the same pools has to go through it.
+ *
+ * When the shared pool is empty too, the elements cached by the other CPUs
+ * are taken back (membarrier rseq fence) before NULL is returned. Without
+ * MEMBARRIER_CMD_PRIVATE_EXPEDITED_RSEQ nothing is cached per CPU.
+ *
+ * Elements sitting in a per-CPU cache still count as used in the pool
+ * statistics until they are handed back to the shared pool.
+ *
+ * With MEMP_HARDEN every free is checked against the allocation bitmap of
+ * its pool, shared with memp_free, so a double free is caught whether the
+ * element sits in the cache of any CPU or in the shared pool. Cached
+ * elements are poisoned and checked before reuse (MEMP_HARDEN_POISON) but
+ * skip the quarantine.
+ */
+
+/** Maximum number of CPUs with their own cache, CPUs above use the shared pool */
+#ifndef MEMP_PERCPU_MAX_CPUS
+#define MEMP_PERCPU_MAX_CPUS	256
+#endif
+
+/** Maximum number of elements of one pool cached by one CPU */
+#ifndef MEMP_PERCPU_BATCH
+#define MEMP_PERCPU_BATCH	16
+#endif
+
+/**
+ * Get an element, from the cache of the current CPU if possible
+ * @param type the pool to get an element from
+ * @return a pointer to the allocated memory or NULL if the pool is empty
+ */
+void *memp_percpu_malloc(memp_t type);
+
+/**
+ * Put an element in the cache of the current CPU,
+ * or back into the shared pool if that cache is full
+ * @param type the pool mem comes from
+ * @param mem the memp element to free
+ */
+void memp_percpu_free(memp_t type, void *mem);
+
+/**
+ * Give the elements cached by every CPU back to the shared pools
+ */
+void memp_percpu_drain(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MEMP_PERCPU_H_ */
@@ -0,0 +1,173 @@
+/*
+ * memp_shm.c
+ *
+ *  Created on: Oct 19, 2026
+ */
+#include "memp_shm.h"
+
+#if MEMP_STATS && MEMP_STATS_SHM
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "mempool.h"
+
+/* Get the number of entries in an array ('x' must NOT be a pointer!) */
+#define ARRAYSIZE(x) (sizeof(x)/sizeof((x)[0]))
+
+static struct memp_shm_hdr *shm_hdr;
+static size_t shm_len;
+static char shm_name[MEMP_SHM_NAME_LEN];
+
+/* the large object path of mempool is published after the pools */
+#if MEM_USE_LARGE_MMAP
+#define MEMP_SHM_ENTRIES (MEMP_MAX + 1)
+#else
+#define MEMP_SHM_ENTRIES MEMP_MAX
+#endif /* MEM_USE_LARGE_MMAP */
+
+/** Statistics pointer of every published entry */
+static struct stats_mem **shm_stats_ref[MEMP_SHM_ENTRIES];
+/** Private statistics of every entry, restored by memp_shm_unpublish */
+static struct stats_mem *shm_private_stats[MEMP_SHM_ENTRIES];
+/** memp_shm_unlink_at_exit is registered with atexit */
+static int shm_atexit;
+
+/**
+ * Remove the name of the segment on exit. The mapping and the statistics
+ * pointers are left alone: other threads may still allocate until the
+ * process is gone.
+ */
+static void
+memp_shm_unlink_at_exit (void)
+{
+	if (shm_hdr != NULL)
+	{
+		shm_unlink (shm_name);
+	}
+}
+
+/**
+ * Fill one entry of the segment and redirect its statistics there
+ *
+ * @param i index of the entry
+ * @param desc textual description
+ * @param size element size
+ * @param num number of elements
+ * @param stats statistics pointer of the entry
+ */
+static void
+memp_shm_publish_entry (size_t i, const char *desc, uint64_t size, uint64_t num, struct stats_mem **stats)
+{
+	struct memp_shm_pool *pool = &shm_hdr->pools[i];
+
+	strncpy (pool->desc, desc, sizeof(pool->desc) - 1);
+	pool->size = size;
+	pool->num = num;
+	pool->stats = **stats;
+
+	shm_stats_ref[i] = stats;
+	shm_private_stats[i] = *stats;
+	*stats = &pool->stats;
+}
+
+/**
+ * Move the statistics of every pool into a shared memory segment
+ * @return 0 on success, -1 on error
+ */
+int
+memp_shm_publish (void)
+{
+	size_t i;
+	int fd;
+
+	if (shm_hdr != NULL)
+	{
+		return 0;
+	}
+
+	snprintf (shm_name, sizeof(shm_name), MEMP_SHM_NAME_FMT, (long) getpid ());
+	shm_len = sizeof(struct memp_shm_hdr) + MEMP_SHM_ENTRIES * sizeof(struct memp_shm_pool);
+
+	fd = shm_open (shm_name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+	if (fd < 0)
+	{
+#if MEMP_LOG
+		printf("memp_shm_publish: cannot create %s\n", shm_name);
+#endif
+		return -1;
+	}
+	if (ftruncate (fd, (off_t) shm_len) != 0)
+	{
+		close (fd);
+		shm_unlink (shm_name);
+		return -1;
+	}
+	shm_hdr = (struct memp_shm_hdr*) mmap (NULL, shm_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close (fd);
+	if (shm_hdr == MAP_FAILED)
+	{
+		shm_hdr = NULL;
+		shm_unlink (shm_name);
+		return -1;
+	}
+
+	shm_hdr->version = MEMP_SHM_VERSION;
+	shm_hdr->pool_size = sizeof(struct memp_shm_pool);
+	shm_hdr->count_size = sizeof(memp_stats_t);
+	shm_hdr->npools = MEMP_SHM_ENTRIES;
+	shm_hdr->pid = (int64_t) getpid ();
+
+	/* for every pool: copy geometry and current statistics, then redirect memp to the shared copy */
+	for (i = 0; i < ARRAYSIZE(memp_pools); i++)
+	{
+		memp_shm_publish_entry (i, memp_pools[i]->desc, memp_pools[i]->size, memp_pools[i]->num,
+				memp_pools[i]->stats);
+	}
+#if MEM_USE_LARGE_MMAP
+	/* large objects have no fixed geometry */
+	memp_shm_publish_entry (i, "LARGE_MMAP", 0, 0, &mempool_large_stats);
+#endif /* MEM_USE_LARGE_MMAP */
+
+	__sync_synchronize ();
+	shm_hdr->magic = MEMP_SHM_MAGIC;
+
+	/* do not leave a stale segment behind on exit */
+	if (!shm_atexit && atexit (memp_shm_unlink_at_exit) == 0)
+	{
+		shm_atexit = 1;
+	}
+
+	return 0;
+}
+
+/**
+ * Move the statistics back into the process and remove the segment
+ */
+void
+memp_shm_unpublish (void)
+{
+	size_t i;
+
+	if (shm_hdr == NULL)
+	{
+		return;
+	}
+
+	for (i = 0; i < MEMP_SHM_ENTRIES; i++)
+	{
+		*shm_private_stats[i] = shm_hdr->pools[i].stats;
+		*shm_stats_ref[i] = shm_private_stats[i];
+	}
+
+	munmap (shm_hdr, shm_len);
+	shm_unlink (shm_name);
+	shm_hdr = NULL;
+}
+
+#endif /* MEMP_STATS && MEMP_STATS_SHM */
@@ -0,0 +1,72 @@
+/*
+ * memp_shm.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef MEMP_SHM_H_
+#define MEMP_SHM_H_
+
+#include <stdint.h>
+
+#include "memp.h"
+
+/**
+ * Layout of the shared stats segment. Bump MEMP_SHM_VERSION on every change
+ * of struct memp_shm_hdr or struct memp_shm_pool.
+ */
+#define MEMP_SHM_MAGIC		0x504d454dUL /* "MEMP" */
+#define MEMP_SHM_VERSION	2
+
+/** Name of the segment, the argument is the pid of the publishing process */
+#define MEMP_SHM_NAME_FMT	"/memp.%ld"
+#define MEMP_SHM_NAME_LEN	32
+
+#define MEMP_SHM_DESC_LEN	32
+
+/** Geometry and live statistics of one pool */
+struct memp_shm_pool {
+  /** Textual description (desc->desc) */
+  char desc[MEMP_SHM_DESC_LEN];
+  /** Element size */
+  uint64_t size;
+  /** Number of elements */
+  uint64_t num;
+  /** Statistics, updated in place by memp. The name pointer is only valid
+   * inside the publishing process */
+  struct stats_mem stats;
+};
+
+/** Segment header, followed by npools struct memp_shm_pool: the memp pools
+ * and, with MEM_USE_LARGE_MMAP, the large object path of mempool (size 0) */
+struct memp_shm_hdr {
+  /** MEMP_SHM_MAGIC, written last once the segment is complete */
+  uint32_t magic;
+  uint32_t version;
+  /** sizeof(struct memp_shm_pool) */
+  uint32_t pool_size;
+  /** sizeof(memp_stats_t) */
+  uint32_t count_size;
+  uint32_t npools;
+  int64_t pid;
+  struct memp_shm_pool pools[];
+};
+
+#if MEMP_STATS && MEMP_STATS_SHM
+/**
+ * Move the statistics of every pool into a shared memory segment named
+ * after the pid of the process. From then on memp updates them in place.
+ * The segment is removed by memp_shm_unpublish. On exit only its name is
+ * unlinked (atexit), the mapping stays valid for threads still running.
+ * @return 0 on success, -1 on error (statistics stay private)
+ */
+int memp_shm_publish(void);
+
+/**
+ * Move the statistics back into the process and remove the segment.
+ * No other thread may use the pools meanwhile.
+ */
+void memp_shm_unpublish(void);
+#endif /* MEMP_STATS && MEMP_STATS_SHM */
+
+#endif /* MEMP_SHM_H_ */
@@ -4,18 +4,349 @@
  *  Created on: Nov 29, 2017
  *      Author: mati
  */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* mremap */
+#endif
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 #include "memp.h"
+#include "mempool.h"
 
+#ifndef MEM_USE_POOLS_TRY_BIGGER_POOL
 #define MEM_USE_POOLS_TRY_BIGGER_POOL 1
+#endif
+
+/** Number of size buckets of the freed large regions cache */
+#ifndef MEM_LARGE_CACHE_BUCKETS
+#define MEM_LARGE_CACHE_BUCKETS 16
+#endif
+/** Maximum number of bytes kept mapped in the freed large regions cache */
+#ifndef MEM_LARGE_CACHE_MAX_BYTES
+#define MEM_LARGE_CACHE_MAX_BYTES (64UL * 1024UL * 1024UL)
+#endif
 
 static bool is_initialized = false;
 
+#if MEMP_STATS && MEMP_STATS_MALLOC
+/** Histogram bucket of a request is (used * scale) >> 32, keeps the division out of mempool_malloc */
+static uint64_t stats_hist_scale[MEMP_MAX];
+#endif /* MEMP_STATS && MEMP_STATS_MALLOC */
+
+/**
+ * Initialize all memory pools once. Safe to call multiple times,
+ * only the first call has any effect.
+ */
+void
+mempool_init (void)
+{
+	if (!is_initialized)
+	{
+		memp_t poolnr;
+
+		/* the first pool that fits has to be the smallest one, see pools.h */
+		for (poolnr = (memp_t) (MEMP_POOL_FIRST + 1); poolnr <= MEMP_POOL_LAST; poolnr = (memp_t) (poolnr + 1))
+		{
+			assert(memp_pools[poolnr - 1]->size < memp_pools[poolnr]->size);
+		}
+#if MEMP_STATS && MEMP_STATS_MALLOC
+		for (poolnr = MEMP_POOL_FIRST; poolnr <= MEMP_POOL_LAST; poolnr = (memp_t) (poolnr + 1))
+		{
+			stats_hist_scale[poolnr] = ((uint64_t) MEMP_STATS_HIST_BUCKETS << 32) / memp_pools[poolnr]->size;
+		}
+#endif /* MEMP_STATS && MEMP_STATS_MALLOC */
+
+		memp_init ();
+		is_initialized = true;
+	}
+}
+
+#if MEM_USE_LARGE_MMAP
+/** Header at the beginning of every mmap'ed large object region */
+struct mempool_large {
+	/** Length of the whole mapping */
+	size_t length;
+	/** Next region of the same cache bucket, only used while cached */
+	struct mempool_large *next;
+	/** Has to be the last member: mempool_free looks for it right in front of user memory */
+	struct memp_malloc_helper helper;
+};
+
+/** Bytes from the header to the user memory */
+#define MEMPOOL_LARGE_STRUCT_SIZE (offsetof(struct mempool_large, helper) + MEMP_ALIGN_SIZE(sizeof(struct memp_malloc_helper)))
+/** Bytes of the mapping in front of the user memory, keeps it MEMPOOL_LARGE_ALIGNMENT aligned */
+#define MEMPOOL_LARGE_HDR_SIZE \
+	((MEMPOOL_LARGE_STRUCT_SIZE + MEMPOOL_LARGE_ALIGNMENT - 1U) & ~(size_t) (MEMPOOL_LARGE_ALIGNMENT - 1U))
+/** The header is placed right in front of the user memory, this much after the start of the mapping */
+#define MEMPOOL_LARGE_LEAD (MEMPOOL_LARGE_HDR_SIZE - MEMPOOL_LARGE_STRUCT_SIZE)
+/** Start of the mapping of a header */
+#define MEMPOOL_LARGE_MAP(large) ((void*) ((uint8_t*) (large) - MEMPOOL_LARGE_LEAD))
+
+/** Recently freed regions, bucket n holds regions of [2^n, 2^(n+1)) pages */
+static struct mempool_large *large_cache[MEM_LARGE_CACHE_BUCKETS];
+static size_t large_cache_bytes;
+static memp_count_t large_cache_count;
+static size_t large_page_size;
+
+#if MEMP_STATS
+static struct stats_mem large_stats = { .name = "LARGE_MMAP" };
+struct stats_mem *mempool_large_stats = &large_stats;
+#endif /* MEMP_STATS */
+
+/**
+ * Round a large object request up to the length of its mapping
+ *
+ * @param size the size in bytes of the memory needed
+ * @return mapping length or 0 on overflow
+ */
+static size_t
+mempool_large_length (size_t size)
+{
+	size_t length;
+
+	if (large_page_size == 0)
+	{
+		large_page_size = (size_t) sysconf (_SC_PAGESIZE);
+	}
+	if (size > SIZE_MAX - MEMPOOL_LARGE_HDR_SIZE - large_page_size)
+	{
+		return 0;
+	}
+	length = size + MEMPOOL_LARGE_HDR_SIZE;
+	return (length + large_page_size - 1) & ~(large_page_size - 1);
+}
+
+/**
+ * Get the cache bucket of a mapping length
+ * @param length
+ */
+static unsigned int
+mempool_large_bucket (size_t length)
+{
+	unsigned int bucket = 0;
+	size_t pages = length / large_page_size;
+
+	while (pages > 1 && bucket < MEM_LARGE_CACHE_BUCKETS - 1)
+	{
+		pages >>= 1;
+		bucket++;
+	}
+	return bucket;
+}
+
+/**
+ * Take a region of at least 'length' bytes (and less than twice as much)
+ * out of the cache. Such a region is either in the bucket of 'length'
+ * or in the next one.
+ *
+ * @param length the mapping length needed
+ * @return cached region or NULL if none fits
+ */
+static struct mempool_large *
+mempool_large_cache_get (size_t length)
+{
+	struct mempool_large **prev;
+	struct mempool_large *large;
+	unsigned int bucket;
+	unsigned int last;
+
+	bucket = mempool_large_bucket (length);
+	last = bucket + 1 < MEM_LARGE_CACHE_BUCKETS ? bucket + 1 : bucket;
+	for (; bucket <= last; bucket++)
+	{
+		for (prev = &large_cache[bucket]; *prev != NULL; prev = &(*prev)->next)
+		{
+			large = *prev;
+			if (large->length >= length && large->length / 2 < length)
+			{
+				*prev = large->next;
+				large_cache_bytes -= large->length;
+				large_cache_count--;
+				return large;
+			}
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Keep a freed region for reuse, or unmap it if the cache is full
+ * @param large
+ */
+static void
+mempool_large_cache_put (struct mempool_large *large)
+{
+	unsigned int bucket;
+
+	if (large->length > MEM_LARGE_CACHE_MAX_BYTES - large_cache_bytes)
+	{
+		munmap (MEMPOOL_LARGE_MAP(large), large->length);
+		return;
+	}
+	bucket = mempool_large_bucket (large->length);
+	large->next = large_cache[bucket];
+	large_cache[bucket] = large;
+	large_cache_bytes += large->length;
+	large_cache_count++;
+}
+
+/**
+ * Allocate a request too big for any pool from a cached or new mapping
+ *
+ * @param size the size in bytes of the memory needed
+ * @return a pointer to the allocated memory or NULL if mmap failed
+ */
+static void *
+mempool_large_malloc (size_t size)
+{
+	struct mempool_large *large;
+	void *map;
+	size_t length;
+
+	length = mempool_large_length (size);
+	if (length == 0)
+	{
+		return NULL;
+	}
+
+	large = mempool_large_cache_get (length);
+	if (large == NULL)
+	{
+		map = mmap (NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (map == MAP_FAILED)
+		{
+#if MEMP_LOG
+			printf("mem_malloc(): mmap of %lu bytes failed!\n", (unsigned long) length);
+#endif
+#if MEMP_STATS
+			mempool_large_stats->err++;
+#endif
+			return NULL;
+		}
+		large = (struct mempool_large*) (void*) ((uint8_t*) map + MEMPOOL_LARGE_LEAD);
+		large->length = length;
+	}
+
+	large->next = NULL;
+	large->helper.poolnr = MEMP_MAX;
+#if MEMP_OVERFLOW_CHECK || MEMP_STATS_MALLOC
+	large->helper.size = size;
+#endif /* MEMP_OVERFLOW_CHECK || MEMP_STATS_MALLOC */
+
+#if MEMP_STATS
+	mempool_large_stats->allocs++;
+	mempool_large_stats->used++;
+	if (mempool_large_stats->used > mempool_large_stats->max)
+	{
+		mempool_large_stats->max = mempool_large_stats->used;
+	}
+#endif
+	return (uint8_t*) large + MEMPOOL_LARGE_STRUCT_SIZE;
+}
+
+/**
+ * Give a large object region back to the cache
+ * @param hmem helper of the large object
+ */
+static void
+mempool_large_free (struct memp_malloc_helper *hmem)
+{
+	struct mempool_large *large;
+
+	large = (struct mempool_large*) (void*) ((uint8_t*) hmem - offsetof(struct mempool_large, helper));
+#if MEMP_STATS
+	mempool_large_stats->used--;
+	mempool_large_stats->frees++;
+#endif
+	mempool_large_cache_put (large);
+}
+
+/**
+ * Resize a large object in place or move it with mremap
+ *
+ * @param hmem helper of the large object
+ * @param size the new size in bytes
+ * @return a pointer to the resized memory or NULL if mremap failed
+ */
+static void *
+mempool_large_realloc (struct memp_malloc_helper *hmem, size_t size)
+{
+	struct mempool_large *large;
+	void *map;
+	size_t length;
+
+	large = (struct mempool_large*) (void*) ((uint8_t*) hmem - offsetof(struct mempool_large, helper));
+	length = mempool_large_length (size);
+	if (length == 0)
+	{
+		return NULL;
+	}
+
+	if (length != large->length)
+	{
+		map = mremap (MEMPOOL_LARGE_MAP(large), large->length, length, MREMAP_MAYMOVE);
+		if (map == MAP_FAILED)
+		{
+#if MEMP_STATS
+			mempool_large_stats->err++;
+#endif
+			return NULL;
+		}
+		large = (struct mempool_large*) (void*) ((uint8_t*) map + MEMPOOL_LARGE_LEAD);
+		large->length = length;
+	}
+#if MEMP_OVERFLOW_CHECK || MEMP_STATS_MALLOC
+	large->helper.size = size;
+#endif /* MEMP_OVERFLOW_CHECK || MEMP_STATS_MALLOC */
+	return (uint8_t*) large + MEMPOOL_LARGE_STRUCT_SIZE;
+}
+#endif /* MEM_USE_LARGE_MMAP */
+
+#if MEMP_STATS && MEMP_STATS_MALLOC
+/**
+ * Account a request served by an element of a malloc pool
+ *
+ * @param poolnr the pool the element comes from
+ * @param fitting the smallest pool the request fits
+ * @param used the bytes of the element taken by the request
+ */
+void
+mempool_stats_malloc (memp_t poolnr, memp_t fitting, size_t used)
+{
+	struct stats_mem *stats = MEMP_DESC_STATS(memp_pools[poolnr]);
+	size_t bucket = (size_t) ((used * stats_hist_scale[poolnr]) >> 32);
+
+	if (bucket >= MEMP_STATS_HIST_BUCKETS)
+	{
+		bucket = MEMP_STATS_HIST_BUCKETS - 1;
+	}
+	stats->hist[bucket]++;
+	stats->frag_bytes += memp_pools[poolnr]->size - used;
+	if (memp_pools[poolnr]->size > memp_pools[fitting]->size)
+	{
+		MEMP_DESC_STATS(memp_pools[fitting])->spill++;
+	}
+}
+
+/**
+ * Account the release of an element of a malloc pool
+ *
+ * @param poolnr the pool the element comes from
+ * @param used the bytes of the element taken by its request
+ */
+void
+mempool_stats_free (memp_t poolnr, size_t used)
+{
+	MEMP_DESC_STATS(memp_pools[poolnr])->frag_bytes -= memp_pools[poolnr]->size - used;
+}
+#endif /* MEMP_STATS && MEMP_STATS_MALLOC */
+
 /**
  * Allocate memory: determine the smallest pool that is big enough
  * to contain an element of 'size' and get an element from that pool.
@@ -26,16 +357,14 @@ static bool is_initialized = false;
 void *
 mempool_malloc (size_t size)
 {
-
-	if (!is_initialized)
-	{
-		memp_init ();
-		is_initialized = true;
-	}
+	mempool_init ();
 
 	void *ret;
 	struct memp_malloc_helper *element = NULL;
 	memp_t poolnr;
+#if MEMP_STATS && MEMP_STATS_MALLOC
+	memp_t fitting = MEMP_MAX;
+#endif /* MEMP_STATS && MEMP_STATS_MALLOC */
 	size_t required_size = size + MEMP_ALIGN_SIZE(sizeof(struct memp_malloc_helper));
 
 	for (poolnr = MEMP_POOL_FIRST; poolnr <= MEMP_POOL_LAST; poolnr = (memp_t) (poolnr + 1))
@@ -44,6 +373,12 @@ mempool_malloc (size_t size)
 		 plus a struct memp_malloc_helper that saves the pool this element came from? */
 		if (required_size <= memp_pools[poolnr]->size)
 		{
+#if MEMP_STATS && MEMP_STATS_MALLOC
+			if (fitting == MEMP_MAX)
+			{
+				fitting = poolnr;
+			}
+#endif /* MEMP_STATS && MEMP_STATS_MALLOC */
 			element = (struct memp_malloc_helper*) memp_malloc(poolnr);
 			if (element == NULL)
 			{
@@ -65,10 +400,14 @@ mempool_malloc (size_t size)
 	}
 	if (poolnr > MEMP_POOL_LAST)
 	{
+#if MEM_USE_LARGE_MMAP
+		return mempool_large_malloc (size);
+#else
 #if MEMP_LOG
 		printf("mem_malloc(): no pool is that big!\n");
 #endif
 		return NULL;
+#endif /* MEM_USE_LARGE_MMAP */
 	}
 
 	/* save the pool number this element came from */
@@ -76,10 +415,12 @@ mempool_malloc (size_t size)
 	/* and return a pointer to the memory directly after the struct memp_malloc_helper */
 	ret = (uint8_t*) element + MEMP_ALIGN_SIZE(sizeof(struct memp_malloc_helper));
 
-#if MEMP_OVERFLOW_CHECK || MEM_STATS
+#if MEMP_OVERFLOW_CHECK || MEMP_STATS_MALLOC
 	element->size = size;
-	// MEM_STATS_INC_USED(used, element->size);
-#endif /* MEMP_OVERFLOW_CHECK || MEM_STATS */
+#endif /* MEMP_OVERFLOW_CHECK || MEMP_STATS_MALLOC */
+#if MEMP_STATS && MEMP_STATS_MALLOC
+	mempool_stats_malloc (poolnr, fitting, required_size);
+#endif /* MEMP_STATS && MEMP_STATS_MALLOC */
 #if MEMP_OVERFLOW_CHECK
 	/* initialize unused memory (diff between requested size and selected pool's size) */
 	memset ((uint8_t*) element + required_size, 0xcd, memp_pools[poolnr]->size - required_size);
@@ -99,27 +440,129 @@ mempool_free (void *rmem)
 {
 	struct memp_malloc_helper *hmem;
 
+	if (rmem == NULL)
+	{
+		return;
+	}
+
 	/* get the original struct memp_malloc_helper */
 	/* cast through void* to get rid of alignment warnings */
 	hmem = (struct memp_malloc_helper*) (void*) ((uint8_t*) rmem - MEMP_ALIGN_SIZE(sizeof(struct memp_malloc_helper)));
 
+#if MEM_USE_LARGE_MMAP
+	if (hmem->poolnr == MEMP_MAX)
+	{
+		mempool_large_free (hmem);
+		return;
+	}
+#endif /* MEM_USE_LARGE_MMAP */
+
 #if MEMP_OVERFLOW_CHECK
 	{
-		uint16_t i;
+		size_t i;
 		assert(hmem->size <= memp_pools[hmem->poolnr]->size && "MEM_USE_POOLS: invalid chunk size");
 		/* check that unused memory remained untouched (diff between requested size and selected pool's size) */
 		for (i = hmem->size + MEMP_ALIGN_SIZE(sizeof(struct memp_malloc_helper)); i < memp_pools[hmem->poolnr]->size;
 				i++)
 		{
-			uint8_t data = *((uint8_t*) rmem + i);
+			uint8_t data = *((uint8_t*) hmem + i);
 
 			assert(data == 0xcd && "mem overflow detected");
 		}
 	}
 #endif /* MEMP_OVERFLOW_CHECK */
 
+#if MEMP_STATS && MEMP_STATS_MALLOC
+	mempool_stats_free ((memp_t) hmem->poolnr, hmem->size + MEMP_ALIGN_SIZE(sizeof(struct memp_malloc_helper)));
+#endif /* MEMP_STATS && MEMP_STATS_MALLOC */
+
 	/* and put it in the pool we saved earlier */
-	memp_free (hmem->poolnr, hmem);
+	memp_free ((memp_t) hmem->poolnr, hmem);
+}
+
+/**
+ * Change the size of memory previously allocated by mempool_malloc.
+ * Pool elements are resized in place while the new size fits their pool,
+ * large objects are resized with mremap, otherwise the data is moved.
+ *
+ * @param rmem the memory element to resize, NULL behaves like mempool_malloc
+ * @param size the new size in bytes, 0 behaves like mempool_free
+ * @return a pointer to the resized memory or NULL, rmem stays valid on failure
+ */
+void *
+mempool_realloc (void *rmem, size_t size)
+{
+	struct memp_malloc_helper *hmem;
+	size_t old_size;
+	void *ret;
+
+	if (rmem == NULL)
+	{
+		return mempool_malloc (size);
+	}
+	if (size == 0)
+	{
+		mempool_free (rmem);
+		return NULL;
+	}
+
+	hmem = (struct memp_malloc_helper*) (void*) ((uint8_t*) rmem - MEMP_ALIGN_SIZE(sizeof(struct memp_malloc_helper)));
+
+#if MEM_USE_LARGE_MMAP
+	if (hmem->poolnr == MEMP_MAX)
+	{
+		memp_t poolnr;
+		struct mempool_large *large;
+
+		for (poolnr = MEMP_POOL_FIRST; poolnr <= MEMP_POOL_LAST; poolnr = (memp_t) (poolnr + 1))
+		{
+			if (size + MEMP_ALIGN_SIZE(sizeof(struct memp_malloc_helper)) <= memp_pools[poolnr]->size)
+			{
+				break;
+			}
+		}
+		if (poolnr > MEMP_POOL_LAST)
+		{
+			/* still too big for any pool */
+			return mempool_large_realloc (hmem, size);
+		}
+		large = (struct mempool_large*) (void*) ((uint8_t*) hmem - offsetof(struct mempool_large, helper));
+		old_size = large->length - MEMPOOL_LARGE_HDR_SIZE;
+	}
+	else
+#endif /* MEM_USE_LARGE_MMAP */
+	{
+		size_t required_size = size + MEMP_ALIGN_SIZE(sizeof(struct memp_malloc_helper));
+
+		if (required_size <= memp_pools[hmem->poolnr]->size)
+		{
+#if MEMP_STATS && MEMP_STATS_MALLOC
+			mempool_stats_free ((memp_t) hmem->poolnr, hmem->size + MEMP_ALIGN_SIZE(sizeof(struct memp_malloc_helper)));
+			mempool_stats_malloc ((memp_t) hmem->poolnr, (memp_t) hmem->poolnr, required_size);
+#endif /* MEMP_STATS && MEMP_STATS_MALLOC */
+#if MEMP_OVERFLOW_CHECK || MEMP_STATS_MALLOC
+			hmem->size = size;
+#endif /* MEMP_OVERFLOW_CHECK || MEMP_STATS_MALLOC */
+#if MEMP_OVERFLOW_CHECK
+			memset ((uint8_t*) hmem + required_size, 0xcd, memp_pools[hmem->poolnr]->size - required_size);
+#endif /* MEMP_OVERFLOW_CHECK */
+			return rmem;
+		}
+#if MEMP_OVERFLOW_CHECK || MEMP_STATS_MALLOC
+		old_size = hmem->size;
+#else
+		old_size = memp_pools[hmem->poolnr]->size - MEMP_ALIGN_SIZE(sizeof(struct memp_malloc_helper));
+#endif /* MEMP_OVERFLOW_CHECK || MEMP_STATS_MALLOC */
+	}
+
+	ret = mempool_malloc (size);
+	if (ret == NULL)
+	{
+		return NULL;
+	}
+	memcpy (ret, rmem, old_size < size ? old_size : size);
+	mempool_free (rmem);
+	return ret;
 }
 
 /**
@@ -134,12 +577,34 @@ mempool_stats_display (void)
 	for (poolnr = MEMP_POOL_FIRST; poolnr <= MEMP_POOL_LAST; poolnr = (memp_t) (poolnr + 1))
 	{
 
-		printf ("\nMEM %s\n\t", memp_pools[poolnr]->stats->name);
-		printf ("avail: %lu \n\t", (uint32_t) memp_pools[poolnr]->stats->avail);
-		printf ("used: %lu \n\t", (uint32_t) memp_pools[poolnr]->stats->used);
-		printf ("max: %lu \n\t", (uint32_t) memp_pools[poolnr]->stats->max);
-		printf ("err: %lu \n", (uint32_t) memp_pools[poolnr]->stats->err);
+		printf ("\nMEM %s\n\t", MEMP_DESC_STATS(memp_pools[poolnr])->name);
+		printf ("avail: %llu \n\t", (unsigned long long) MEMP_DESC_STATS(memp_pools[poolnr])->avail);
+		printf ("used: %llu \n\t", (unsigned long long) MEMP_DESC_STATS(memp_pools[poolnr])->used);
+		printf ("max: %llu \n\t", (unsigned long long) MEMP_DESC_STATS(memp_pools[poolnr])->max);
+		printf ("err: %llu \n", (unsigned long long) MEMP_DESC_STATS(memp_pools[poolnr])->err);
+#if MEMP_STATS_MALLOC
+		{
+			int i;
+
+			printf ("\tspill: %llu \n\t", (unsigned long long) MEMP_DESC_STATS(memp_pools[poolnr])->spill);
+			printf ("frag: %llu bytes \n\t", (unsigned long long) MEMP_DESC_STATS(memp_pools[poolnr])->frag_bytes);
+			printf ("hist:");
+			for (i = 0; i < MEMP_STATS_HIST_BUCKETS; i++)
+			{
+				printf (" %llu", (unsigned long long) MEMP_DESC_STATS(memp_pools[poolnr])->hist[i]);
+			}
+			printf (" \n");
+		}
+#endif /* MEMP_STATS_MALLOC */
 	}
+#if MEM_USE_LARGE_MMAP
+	printf ("\nMEM %s\n\t", mempool_large_stats->name);
+	printf ("used: %llu \n\t", (unsigned long long) mempool_large_stats->used);
+	printf ("max: %llu \n\t", (unsigned long long) mempool_large_stats->max);
+	printf ("err: %llu \n\t", (unsigned long long) mempool_large_stats->err);
+	printf ("cached: %llu (%llu bytes) \n", (unsigned long long) large_cache_count,
+			(unsigned long long) large_cache_bytes);
+#endif /* MEM_USE_LARGE_MMAP */
 #endif
 
 }
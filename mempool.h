@@ -5,6 +5,32 @@
  *      Author: mati
  */
 
+#ifndef MEMPOOL_H_
+#define MEMPOOL_H_
+
+#include "memp.h"
+
+/** Serve requests bigger than the biggest malloc pool from mmap'ed regions */
+#ifndef MEM_USE_LARGE_MMAP
+#define MEM_USE_LARGE_MMAP 1
+#endif
+
+/** Alignment of the memory of requests served by the large object path */
+#ifndef MEMPOOL_LARGE_ALIGNMENT
+#define MEMPOOL_LARGE_ALIGNMENT 16
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Initialize all memory pools once. Called implicitly by mempool_malloc,
+ * users bypassing it (e.g. arena) must call it before touching the pools.
+ */
+void
+mempool_init (void);
+
 /**
  * Free memory previously allocated by mem_malloc. Loads the pool number
  * and calls memp_free with that pool number to put the element back into
@@ -25,8 +51,54 @@ mempool_free (void *rmem);
 void *
 mempool_malloc (size_t size);
 
+/**
+ * Change the size of memory previously allocated by mempool_malloc.
+ * Requests bigger than the biggest pool are backed by mremap.
+ *
+ * @param rmem the memory element to resize, NULL behaves like mempool_malloc
+ * @param size the new size in bytes, 0 behaves like mempool_free
+ * @return a pointer to the resized memory or NULL, rmem stays valid on failure
+ */
+void *
+mempool_realloc (void *rmem, size_t size);
+
 /**
  * Display memory stats from all allocated memory pools in
  */
 void
 mempool_stats_display (void);
+
+#if MEMP_STATS && MEMP_STATS_MALLOC
+/**
+ * Account a request served by an element of a malloc pool. Called by
+ * mempool_malloc and by users taking elements with memp_malloc directly
+ * (mempool_resource, arena), so their waste and spills are reported too.
+ *
+ * @param poolnr the pool the element comes from
+ * @param fitting the smallest pool the request fits, a spill when smaller than poolnr
+ * @param used the bytes of the element taken by the request (headers included)
+ */
+void
+mempool_stats_malloc (memp_t poolnr, memp_t fitting, size_t used);
+
+/**
+ * Account the release of an element accounted with mempool_stats_malloc
+ *
+ * @param poolnr the pool the element comes from
+ * @param used the bytes of the element taken by its request
+ */
+void
+mempool_stats_free (memp_t poolnr, size_t used);
+#endif /* MEMP_STATS && MEMP_STATS_MALLOC */
+
+#if MEM_USE_LARGE_MMAP && MEMP_STATS
+/** Statistics of the large object path. Like memp_desc::stats this is a
+ * pointer so they can be moved into the shared stats segment */
+extern struct stats_mem *mempool_large_stats;
+#endif /* MEM_USE_LARGE_MMAP && MEMP_STATS */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MEMPOOL_H_ */
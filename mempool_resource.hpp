@@ -0,0 +1,260 @@
+/*
+ * mempool_resource.hpp
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef MEMPOOL_RESOURCE_HPP_
+#define MEMPOOL_RESOURCE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory_resource>
+#include <new>
+
+#include "memp.h"
+#include "mempool.h"
+
+/**
+ * std::pmr::memory_resource over the MALLOC_MEMPOOL size classes.
+ *
+ * Containers pass the size (and alignment) back on deallocation, so unlike
+ * mempool_malloc no struct memp_malloc_helper is stored in front of the
+ * object: the pool is found again from the element address. Requests above
+ * the biggest class go to mempool_malloc (large object path).
+ *
+ * Alignments above what the memory is aligned to anyway (native_alignment:
+ * the pool base plus element stride, or MEMPOOL_LARGE_ALIGNMENT for the large
+ * object path) are served by over-allocating and keeping the offset to the
+ * element start right in front of the returned pointer.
+ *
+ *	std::pmr::vector<int> v(mempool_resource::instance());
+ */
+class mempool_resource : public std::pmr::memory_resource
+{
+public:
+	/** The process wide resource, pools are global */
+	static mempool_resource *instance () noexcept
+	{
+		static mempool_resource resource;
+		return &resource;
+	}
+
+	/**
+	 * Allocate from the smallest malloc pool that fits (or a bigger one
+	 * when it is empty, as mempool_malloc does)
+	 * @throw std::bad_alloc when every fitting pool is empty
+	 */
+	static void *allocate_bytes (std::size_t bytes, std::size_t alignment)
+	{
+		uint8_t *raw;
+		uint8_t *ret;
+		std::size_t offset;
+
+		if (alignment <= native_alignment (bytes))
+		{
+			return allocate_raw (bytes);
+		}
+		if (bytes > SIZE_MAX - alignment - sizeof(std::size_t))
+		{
+			throw std::bad_alloc ();
+		}
+
+		raw = static_cast<uint8_t *> (allocate_raw (bytes + alignment - 1 + sizeof(std::size_t)));
+		ret = reinterpret_cast<uint8_t *> ((reinterpret_cast<uintptr_t> (raw) + sizeof(std::size_t) + alignment - 1)
+				& ~static_cast<uintptr_t> (alignment - 1));
+		offset = static_cast<std::size_t> (ret - raw);
+		std::memcpy (ret - sizeof(std::size_t), &offset, sizeof(std::size_t));
+		return ret;
+	}
+
+	/**
+	 * Give memory obtained with the same bytes and alignment back
+	 */
+	static void deallocate_bytes (void *p, std::size_t bytes, std::size_t alignment) noexcept
+	{
+		std::size_t offset;
+
+		if (alignment <= native_alignment (bytes))
+		{
+			deallocate_raw (p, bytes);
+			return;
+		}
+
+		std::memcpy (&offset, static_cast<uint8_t *> (p) - sizeof(std::size_t), sizeof(std::size_t));
+		deallocate_raw (static_cast<uint8_t *> (p) - offset, bytes + alignment - 1 + sizeof(std::size_t));
+	}
+
+	/**
+	 * Alignment every allocation of 'bytes' gets without over-allocating.
+	 * Only depends on 'bytes', allocate_bytes and deallocate_bytes agree on it.
+	 */
+	static std::size_t native_alignment (std::size_t bytes) noexcept
+	{
+		memp_t poolnr;
+
+		for (poolnr = MEMP_POOL_FIRST; poolnr <= MEMP_POOL_LAST; poolnr = (memp_t) (poolnr + 1))
+		{
+			if (pool_fits (poolnr, bytes))
+			{
+				return pool_alignment ();
+			}
+		}
+		return MEMPOOL_LARGE_ALIGNMENT;
+	}
+
+protected:
+	void *do_allocate (std::size_t bytes, std::size_t alignment) override
+	{
+		return allocate_bytes (bytes, alignment);
+	}
+
+	void do_deallocate (void *p, std::size_t bytes, std::size_t alignment) override
+	{
+		deallocate_bytes (p, bytes, alignment);
+	}
+
+	bool do_is_equal (const std::pmr::memory_resource &other) const noexcept override
+	{
+		return this == &other;
+	}
+
+private:
+	/** Alignment guaranteed by every element of every malloc pool: the lowest
+	 * set bit of the first element address and of the element stride */
+	static std::size_t pool_alignment () noexcept
+	{
+		static const std::size_t alignment = [] {
+			uintptr_t bits = 0;
+			memp_t poolnr;
+
+			for (poolnr = MEMP_POOL_FIRST; poolnr <= MEMP_POOL_LAST; poolnr = (memp_t) (poolnr + 1))
+			{
+				bits |= reinterpret_cast<uintptr_t> (MEM_ALIGN(memp_pools[poolnr]->base));
+				bits |= MEMP_ELEMENT_STRIDE(memp_pools[poolnr]->size);
+			}
+			return static_cast<std::size_t> (bits & (~bits + 1));
+		} ();
+
+		return alignment;
+	}
+
+	/** Is an element of this pool able to hold 'bytes' */
+	static bool pool_fits (memp_t poolnr, std::size_t bytes) noexcept
+	{
+		return bytes <= memp_pools[poolnr]->size;
+	}
+
+	/** Does 'p' point into the storage of this pool */
+	static bool pool_owns (memp_t poolnr, const void *p) noexcept
+	{
+		const struct memp_desc *desc = memp_pools[poolnr];
+		const uint8_t *start = static_cast<const uint8_t *> (MEM_ALIGN(desc->base));
+
+		return static_cast<const uint8_t *> (p) >= start
+				&& static_cast<const uint8_t *> (p) < start + desc->num * MEMP_ELEMENT_STRIDE(desc->size);
+	}
+
+	static void *allocate_raw (std::size_t bytes)
+	{
+		memp_t poolnr;
+		memp_t fitting = MEMP_MAX;
+		void *ret;
+
+		mempool_init ();
+
+		for (poolnr = MEMP_POOL_FIRST; poolnr <= MEMP_POOL_LAST; poolnr = (memp_t) (poolnr + 1))
+		{
+			if (pool_fits (poolnr, bytes))
+			{
+				if (fitting == MEMP_MAX)
+				{
+					fitting = poolnr;
+				}
+				ret = memp_malloc(poolnr);
+				if (ret != nullptr)
+				{
+#if MEMP_STATS && MEMP_STATS_MALLOC
+					mempool_stats_malloc (poolnr, fitting, bytes);
+#endif /* MEMP_STATS && MEMP_STATS_MALLOC */
+					return ret;
+				}
+				/* this pool is empty, try a bigger one */
+			}
+		}
+		ret = fitting != MEMP_MAX ? nullptr : mempool_malloc (bytes);
+		if (ret == nullptr)
+		{
+			throw std::bad_alloc ();
+		}
+		return ret;
+	}
+
+	static void deallocate_raw (void *p, std::size_t bytes) noexcept
+	{
+		memp_t poolnr;
+
+		for (poolnr = MEMP_POOL_FIRST; poolnr <= MEMP_POOL_LAST; poolnr = (memp_t) (poolnr + 1))
+		{
+			if (pool_fits (poolnr, bytes) && pool_owns (poolnr, p))
+			{
+#if MEMP_STATS && MEMP_STATS_MALLOC
+				mempool_stats_free (poolnr, bytes);
+#endif /* MEMP_STATS && MEMP_STATS_MALLOC */
+				memp_free (poolnr, p);
+				return;
+			}
+		}
+		mempool_free (p);
+	}
+};
+
+/**
+ * Stateless STL allocator over mempool_resource, meant for node based
+ * containers (std::map, std::list, std::unordered_map...) where every
+ * node is one small allocation:
+ *
+ *	std::map<int, int, std::less<int>, mempool_allocator<std::pair<const int, int>>> m;
+ */
+template <typename T>
+class mempool_allocator
+{
+public:
+	using value_type = T;
+
+	mempool_allocator () noexcept = default;
+
+	template <typename U>
+	mempool_allocator (const mempool_allocator<U>&) noexcept
+	{
+	}
+
+	T *allocate (std::size_t n)
+	{
+		if (n > static_cast<std::size_t> (-1) / sizeof(T))
+		{
+			throw std::bad_alloc ();
+		}
+		return static_cast<T *> (mempool_resource::allocate_bytes (n * sizeof(T), alignof(T)));
+	}
+
+	void deallocate (T *p, std::size_t n) noexcept
+	{
+		mempool_resource::deallocate_bytes (p, n * sizeof(T), alignof(T));
+	}
+
+	template <typename U>
+	bool operator== (const mempool_allocator<U>&) const noexcept
+	{
+		return true;
+	}
+
+	template <typename U>
+	bool operator!= (const mempool_allocator<U>&) const noexcept
+	{
+		return false;
+	}
+};
+
+#endif /* MEMPOOL_RESOURCE_HPP_ */
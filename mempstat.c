@@ -0,0 +1,149 @@
+/*
+ * mempstat.c
+ *
+ *  Created on: Oct 19, 2026
+ *
+ * Standalone reader of the shared stats segment published by memp_shm_publish.
+ * Usage: mempstat <pid> [interval in seconds]
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "memp_shm.h"
+
+/**
+ * Attach to the stats segment of a process
+ *
+ * @param pid the process to attach to
+ * @param len set to the length of the mapping
+ * @return the mapped segment or NULL on error
+ */
+static const struct memp_shm_hdr *
+mempstat_attach (long pid, size_t *len)
+{
+	char name[MEMP_SHM_NAME_LEN];
+	struct stat st;
+	const struct memp_shm_hdr *hdr;
+	int fd;
+
+	snprintf (name, sizeof(name), MEMP_SHM_NAME_FMT, pid);
+	fd = shm_open (name, O_RDONLY, 0);
+	if (fd < 0)
+	{
+		fprintf (stderr, "mempstat: no stats segment %s\n", name);
+		return NULL;
+	}
+	if (fstat (fd, &st) != 0 || (size_t) st.st_size < sizeof(struct memp_shm_hdr))
+	{
+		close (fd);
+		fprintf (stderr, "mempstat: invalid stats segment %s\n", name);
+		return NULL;
+	}
+	*len = (size_t) st.st_size;
+	hdr = (const struct memp_shm_hdr*) mmap (NULL, *len, PROT_READ, MAP_SHARED, fd, 0);
+	close (fd);
+	if (hdr == MAP_FAILED)
+	{
+		return NULL;
+	}
+
+	if (hdr->magic != MEMP_SHM_MAGIC || hdr->version != MEMP_SHM_VERSION
+			|| hdr->pool_size != sizeof(struct memp_shm_pool) || hdr->count_size != sizeof(memp_stats_t)
+			|| sizeof(struct memp_shm_hdr) + (size_t) hdr->npools * hdr->pool_size > *len)
+	{
+		fprintf (stderr, "mempstat: incompatible stats segment %s (version %u)\n", name, hdr->version);
+		munmap ((void*) hdr, *len);
+		return NULL;
+	}
+	return hdr;
+}
+
+int
+main (int argc, char *argv[])
+{
+	const struct memp_shm_hdr *hdr;
+	struct stats_mem *prev;
+	size_t len;
+	uint32_t i;
+	long pid;
+	unsigned int interval = 1;
+
+	if (argc < 2)
+	{
+		fprintf (stderr, "usage: %s <pid> [interval in seconds]\n", argv[0]);
+		return 1;
+	}
+	pid = strtol (argv[1], NULL, 10);
+	if (argc > 2)
+	{
+		interval = (unsigned int) strtoul (argv[2], NULL, 10);
+		if (interval == 0)
+		{
+			interval = 1;
+		}
+	}
+
+	hdr = mempstat_attach (pid, &len);
+	if (hdr == NULL)
+	{
+		return 1;
+	}
+	prev = calloc (hdr->npools, sizeof(*prev));
+	if (prev == NULL)
+	{
+		return 1;
+	}
+	for (i = 0; i < hdr->npools; i++)
+	{
+		prev[i] = hdr->pools[i].stats;
+	}
+
+	/* the publishing process updates the counters in place, we only ever read them.
+	 * EPERM: the process exists but belongs to another user, the segment is still readable */
+	while (kill ((pid_t) pid, 0) == 0 || errno == EPERM)
+	{
+		sleep (interval);
+
+		/* alloc/s, free/s, err/s: rates over the last interval
+		 * unused%: elements of the pool not allocated
+		 * waste%: bytes of allocated elements not covered by their requests (internal fragmentation) */
+		printf ("\n%-16s %8s %10s %10s %10s %10s %10s %10s %10s %7s", "pool", "size", "num", "used", "max", "err",
+				"alloc/s", "free/s", "err/s", "unused%");
+#if MEMP_STATS_MALLOC
+		printf (" %10s %12s %7s", "spill", "frag_bytes", "waste%");
+#endif /* MEMP_STATS_MALLOC */
+		printf ("\n");
+		for (i = 0; i < hdr->npools; i++)
+		{
+			const struct memp_shm_pool *pool = &hdr->pools[i];
+			struct stats_mem cur = pool->stats;
+
+			printf ("%-16.*s %8llu %10llu %10llu %10llu %10llu %10.1f %10.1f %10.1f %7.1f", MEMP_SHM_DESC_LEN,
+					pool->desc, (unsigned long long) pool->size, (unsigned long long) pool->num,
+					(unsigned long long) cur.used, (unsigned long long) cur.max, (unsigned long long) cur.err,
+					(double) (cur.allocs - prev[i].allocs) / interval,
+					(double) (cur.frees - prev[i].frees) / interval,
+					(double) (cur.err - prev[i].err) / interval,
+					pool->num ? 100.0 * (double) (pool->num - cur.used) / (double) pool->num : 0.0);
+#if MEMP_STATS_MALLOC
+			printf (" %10llu %12llu %7.1f", (unsigned long long) cur.spill, (unsigned long long) cur.frag_bytes,
+					cur.used && pool->size ? 100.0 * (double) cur.frag_bytes / ((double) cur.used * (double) pool->size) : 0.0);
+#endif /* MEMP_STATS_MALLOC */
+			printf ("\n");
+			prev[i] = cur;
+		}
+		fflush (stdout);
+	}
+
+	free (prev);
+	munmap ((void*) hdr, len);
+	return 0;
+}
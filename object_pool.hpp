@@ -0,0 +1,246 @@
+/*
+ * object_pool.hpp
+ *
+ *  Created on: Oct 19, 2026
+ */
+
+#ifndef OBJECT_POOL_HPP_
+#define OBJECT_POOL_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <new>
+#include <utility>
+
+#include "memp.h"
+
+/**
+ * Typed memory pool of N objects of type T, generated at compile time.
+ *
+ * Every ObjectPool<T, N> instantiation is one memp pool with its own storage,
+ * element size and alignment derived from sizeof(T)/alignof(T). Objects are
+ * constructed in place and handed out as unique_ptr with a pool deleter:
+ *
+ *	auto conn = ObjectPool<Connection, 64>::make(fd);
+ *	if (!conn) { ...pool exhausted... }
+ *
+ * The pool is named Name when given (it must have static storage duration,
+ * e.g. static constexpr char conn_name[] = "CONN"), "OBJECT_POOL[N]" otherwise.
+ * The name is the desc of the pool (stats name, MEMP_LOG messages). ObjectPool
+ * pools are not in memp_pools, so they are not published by memp_shm.
+ *
+ * Only when both MEMP_OVERFLOW_CHECK and MEMP_HARDEN are 0 allocation and
+ * release are an inlined freelist pop/push, the same as do_memp_malloc_pool/
+ * do_memp_free_pool. Otherwise (MEMP_OVERFLOW_CHECK defaults to 2) they go
+ * through memp_malloc_pool/memp_free_pool to get the checks, see
+ * bench_object_pool.cpp for the cost of both.
+ */
+template <typename T, std::size_t N, const char *Name = nullptr>
+class ObjectPool
+{
+public:
+	/** unique_ptr deleter destroying the object and giving its element back */
+	struct Deleter
+	{
+		void operator() (T *obj) const noexcept
+		{
+			ObjectPool::destroy (obj);
+		}
+	};
+
+	using Handle = std::unique_ptr<T, Deleter>;
+
+	/** Alignment of every element */
+	static constexpr std::size_t align = alignof(T) > alignof(struct memp) ? alignof(T) : alignof(struct memp);
+
+	/** Element size: the object (or the freelist link while free), padded so that
+	 * size + MEMP_SIZE keeps every element aligned */
+	static constexpr std::size_t size =
+			((((sizeof(T) > sizeof(struct memp) ? sizeof(T) : sizeof(struct memp)) + MEMP_SIZE + align - 1) / align)
+					* align) - MEMP_SIZE;
+
+	/** Number of elements */
+	static constexpr std::size_t num = N;
+
+	static_assert (N > 0, "ObjectPool needs at least one element");
+	static_assert (N <= static_cast<memp_count_t> (~static_cast<memp_count_t> (0)),
+			"ObjectPool has more elements than memp_count_t holds, see MEMP_LARGE_POOLS");
+
+	/**
+	 * Construct an object in a pool element
+	 * @return handle to the object, empty if the pool is exhausted
+	 */
+	template <typename... Args>
+	static Handle make (Args&&... args)
+	{
+		return Handle (create (std::forward<Args> (args)...));
+	}
+
+	/**
+	 * Construct an object in a pool element, to be released with destroy
+	 * @return the object or nullptr if the pool is exhausted
+	 */
+	template <typename... Args>
+	static T *create (Args&&... args)
+	{
+		void *mem = allocate ();
+
+		if (mem == nullptr)
+		{
+			return nullptr;
+		}
+		try
+		{
+			return ::new (mem) T (std::forward<Args> (args)...);
+		}
+		catch (...)
+		{
+			deallocate (mem);
+			throw;
+		}
+	}
+
+	/**
+	 * Destroy an object created by create and give its element back
+	 * @param obj may be nullptr
+	 */
+	static void destroy (T *obj) noexcept
+	{
+		if (obj != nullptr)
+		{
+			obj->~T ();
+			deallocate (obj);
+		}
+	}
+
+	/**
+	 * Get raw storage for one T
+	 * @return a pointer to the element or nullptr if the pool is exhausted
+	 */
+	static void *allocate () noexcept
+	{
+		if (!initialized)
+		{
+			init ();
+		}
+#if MEMP_OVERFLOW_CHECK || MEMP_HARDEN
+		return memp_malloc_pool (&desc);
+#else
+		struct memp *memp = tab;
+
+		if (memp == nullptr)
+		{
+#if MEMP_STATS
+			MEMP_DESC_STATS(&desc)->err++;
+#endif
+			return nullptr;
+		}
+		tab = memp->next;
+#if MEMP_STATS
+		MEMP_DESC_STATS(&desc)->allocs++;
+		MEMP_DESC_STATS(&desc)->used++;
+		if (MEMP_DESC_STATS(&desc)->used > MEMP_DESC_STATS(&desc)->max)
+		{
+			MEMP_DESC_STATS(&desc)->max = MEMP_DESC_STATS(&desc)->used;
+		}
+#endif
+		return memp;
+#endif /* MEMP_OVERFLOW_CHECK || MEMP_HARDEN */
+	}
+
+	/**
+	 * Give raw storage obtained from allocate back
+	 * @param mem may be nullptr
+	 */
+	static void deallocate (void *mem) noexcept
+	{
+#if MEMP_OVERFLOW_CHECK || MEMP_HARDEN
+		memp_free_pool (&desc, mem);
+#else
+		struct memp *memp = static_cast<struct memp *> (mem);
+
+		if (memp == nullptr)
+		{
+			return;
+		}
+#if MEMP_STATS
+		MEMP_DESC_STATS(&desc)->used--;
+		MEMP_DESC_STATS(&desc)->frees++;
+#endif
+		memp->next = tab;
+		tab = memp;
+#endif /* MEMP_OVERFLOW_CHECK || MEMP_HARDEN */
+	}
+
+	/** The memp descriptor of this pool */
+	static const struct memp_desc *descriptor () noexcept
+	{
+		return &desc;
+	}
+
+	/** The name of this pool */
+	static const char *name () noexcept
+	{
+		if constexpr (Name == nullptr)
+		{
+			if (name_buf[0] == '\0')
+			{
+				std::snprintf (name_buf, sizeof(name_buf), "OBJECT_POOL[%zu]", N);
+			}
+			return name_buf;
+		}
+		else
+		{
+			return Name;
+		}
+	}
+
+private:
+	/** Name the pool and link its elements */
+	static void init () noexcept
+	{
+		name ();
+#if MEMP_HARDEN
+		harden.allocated = harden_allocated;
+#endif
+		memp_init_pool (&desc);
+		initialized = true;
+	}
+
+	/** Default name "OBJECT_POOL[N]" */
+	static inline char name_buf[32];
+#if MEMP_HARDEN && MEMP_HARDEN_GUARD
+	/** Guard pages can only be protected in page aligned storage */
+	static constexpr std::size_t base_align = MEMP_HARDEN_GUARD_PAGE_SIZE;
+#else
+	static constexpr std::size_t base_align = align;
+#endif /* MEMP_HARDEN && MEMP_HARDEN_GUARD */
+
+	alignas(base_align) static inline uint8_t base[N * MEMP_ELEMENT_STRIDE(size)];
+	static inline struct memp *tab;
+	static inline bool initialized;
+#if MEMP_STATS
+	static inline struct stats_mem stats;
+#if MEMP_STATS_SHM
+	static inline struct stats_mem *stats_ptr = &stats;
+#endif
+#endif
+#if MEMP_HARDEN
+	static inline uint8_t harden_allocated[(N + 7) / 8];
+	static inline struct memp_harden harden;
+#endif
+
+	static inline const struct memp_desc desc = {
+		DECLARE_MEMPOOL_DESC(Name != nullptr ? Name : name_buf)
+		MEMPOOL_DECLARE_STATS_REFERENCE(stats)
+		size,
+		(memp_count_t) N,
+		base,
+		&tab
+		MEMPOOL_DECLARE_HARDEN_REFERENCE(harden)
+	};
+};
+
+#endif /* OBJECT_POOL_HPP_ */
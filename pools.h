@@ -36,6 +36,9 @@
 
 	is allowed.
 
+	Malloc pools have to be declared in ascending "chunk size" order: mempool_malloc
+	serves a request from the first pool big enough (and the next ones when that is
+	empty), mempool_init asserts the order.
 
  */
 
@@ -49,8 +52,8 @@
 
 
 MALLOC_MEMPOOL_START
-MALLOC_MEMPOOL(10, 1024)
 MALLOC_MEMPOOL(20, 512)
+MALLOC_MEMPOOL(10, 1024)
 MALLOC_MEMPOOL_END
 
 #undef MALLOC_MEMPOOL
@@ -0,0 +1,121 @@
+/*
+ * test_harden.c
+ *
+ *  Created on: Oct 19, 2026
+ *
+ * Check that MEMP_HARDEN catches a double free hidden behind another free
+ * (A, B, A), through memp_free and through the per-CPU frontend, and that
+ * the pool hands out every element once afterwards. Violations assert, so
+ * build with NDEBUG to count them instead:
+ *	gcc -O2 -DNDEBUG -DMEMP_HARDEN=1 memp.c memp_percpu.c test_harden.c -o test_harden -lpthread
+ *	gcc -O2 -DNDEBUG -DMEMP_HARDEN=1 -DMEMP_HARDEN_POISON=1 -DMEMP_HARDEN_QUARANTINE=4 memp.c memp_percpu.c test_harden.c -o test_harden -lpthread
+ */
+#include <stdint.h>
+#include <stdio.h>
+
+#include "memp.h"
+#include "memp_percpu.h"
+
+#if !MEMP_HARDEN || !MEMP_STATS
+#error "test_harden needs MEMP_HARDEN and MEMP_STATS"
+#endif
+
+#define TEST_POOL	MEMP_POOL_512
+
+#define TEST_CHECK(cond) \
+	do { \
+		if (!(cond)) \
+		{ \
+			printf ("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			return 1; \
+		} \
+	} while (0)
+
+/**
+ * Take every element of TEST_POOL and check that none is handed out twice
+ * @param percpu allocate through the per-CPU frontend
+ * @return 0 on success
+ */
+static int
+test_exhaust (int percpu)
+{
+	void *elements[256];
+	memp_count_t n;
+	memp_count_t i;
+	memp_count_t j;
+
+	for (n = 0; n < memp_pools[TEST_POOL]->num; n++)
+	{
+		elements[n] = percpu ? memp_percpu_malloc (TEST_POOL) : memp_malloc(TEST_POOL);
+		TEST_CHECK(elements[n] != NULL);
+		for (j = 0; j < n; j++)
+		{
+			TEST_CHECK(elements[j] != elements[n]);
+		}
+	}
+	TEST_CHECK((percpu ? memp_percpu_malloc (TEST_POOL) : memp_malloc(TEST_POOL)) == NULL);
+	for (i = 0; i < n; i++)
+	{
+		if (percpu)
+		{
+			memp_percpu_free (TEST_POOL, elements[i]);
+		}
+		else
+		{
+			memp_free (TEST_POOL, elements[i]);
+		}
+	}
+	return 0;
+}
+
+int
+main (void)
+{
+	struct stats_mem *stats = MEMP_DESC_STATS(memp_pools[TEST_POOL]);
+	memp_stats_t illegal;
+	void *a;
+	void *b;
+
+	TEST_CHECK(memp_pools[TEST_POOL]->num <= 256);
+	memp_init ();
+
+	/* A, B, A through memp_free */
+	a = memp_malloc(TEST_POOL);
+	b = memp_malloc(TEST_POOL);
+	TEST_CHECK(a != NULL && b != NULL);
+	memp_free (TEST_POOL, a);
+	memp_free (TEST_POOL, b);
+	illegal = stats->illegal;
+	memp_free (TEST_POOL, a);
+	TEST_CHECK(stats->illegal == illegal + 1);
+	TEST_CHECK(stats->used == 0);
+	TEST_CHECK(test_exhaust (0) == 0);
+
+	/* A, B, A through the per-CPU frontend */
+	a = memp_percpu_malloc (TEST_POOL);
+	b = memp_percpu_malloc (TEST_POOL);
+	TEST_CHECK(a != NULL && b != NULL);
+	memp_percpu_free (TEST_POOL, a);
+	memp_percpu_free (TEST_POOL, b);
+	illegal = stats->illegal;
+	memp_percpu_free (TEST_POOL, a);
+	TEST_CHECK(stats->illegal == illegal + 1);
+	/* and once more after the elements went back to the shared pool */
+	memp_percpu_drain ();
+	memp_percpu_free (TEST_POOL, b);
+	TEST_CHECK(stats->illegal == illegal + 2);
+	TEST_CHECK(test_exhaust (1) == 0);
+	memp_percpu_drain ();
+	TEST_CHECK(stats->used == 0);
+
+	/* a pointer inside an element is no element */
+	a = memp_malloc(TEST_POOL);
+	illegal = stats->illegal;
+	memp_free (TEST_POOL, (uint8_t*) a + 8);
+	TEST_CHECK(stats->illegal == illegal + 1);
+	memp_free (TEST_POOL, a);
+	TEST_CHECK(stats->illegal == illegal + 1);
+
+	printf ("test_harden: OK\n");
+	return 0;
+}
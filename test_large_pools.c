@@ -0,0 +1,93 @@
+/*
+ * test_large_pools.c
+ *
+ *  Created on: Oct 19, 2026
+ *
+ * Check that a single pool with more than 65535 elements and an extent
+ * above 4GB is fully usable. Needs about 4.5GB of memory.
+ *
+ * Build:
+ *	gcc -O2 -mcmodel=medium -DMEMP_OVERFLOW_CHECK=0 memp.c test_large_pools.c -o test_large_pools
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "memp.h"
+
+#if !MEMP_LARGE_POOLS
+#error "test_large_pools needs MEMP_LARGE_POOLS"
+#endif
+
+#define TEST_NUM	4400000ULL
+#define TEST_SIZE	1000
+
+MEMPOOL_DECLARE(TEST_BIG, TEST_NUM, TEST_SIZE, "TEST_BIG")
+
+#define TEST_CHECK(cond) \
+	do { \
+		if (!(cond)) \
+		{ \
+			printf ("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			return 1; \
+		} \
+	} while (0)
+
+int
+main (void)
+{
+	uint8_t **elements;
+	uint8_t *lowest;
+	uint8_t *highest;
+	memp_count_t i;
+
+	TEST_CHECK(memp_TEST_BIG.num == TEST_NUM);
+	TEST_CHECK((uint64_t) memp_TEST_BIG.num * MEMP_ELEMENT_STRIDE(memp_TEST_BIG.size) > 0x100000000ULL);
+
+	elements = malloc (TEST_NUM * sizeof(*elements));
+	TEST_CHECK(elements != NULL);
+
+	memp_init_pool (&memp_TEST_BIG);
+#if MEMP_STATS
+	TEST_CHECK(MEMP_DESC_STATS(&memp_TEST_BIG)->avail == TEST_NUM);
+#endif
+
+	lowest = highest = NULL;
+	for (i = 0; i < TEST_NUM; i++)
+	{
+		elements[i] = memp_malloc_pool (&memp_TEST_BIG);
+		TEST_CHECK(elements[i] != NULL);
+		elements[i][TEST_SIZE - 1] = (uint8_t) i;
+		if (lowest == NULL || elements[i] < lowest)
+		{
+			lowest = elements[i];
+		}
+		if (highest == NULL || elements[i] > highest)
+		{
+			highest = elements[i];
+		}
+	}
+	/* every element was handed out exactly once and the last ones lie above 4GB */
+	TEST_CHECK(memp_malloc_pool (&memp_TEST_BIG) == NULL);
+	TEST_CHECK((uint64_t) (highest - lowest) == (TEST_NUM - 1) * MEMP_ELEMENT_STRIDE(memp_TEST_BIG.size));
+	TEST_CHECK((uint64_t) (highest - lowest) > 0xffffffffULL);
+#if MEMP_STATS
+	TEST_CHECK(MEMP_DESC_STATS(&memp_TEST_BIG)->used == TEST_NUM);
+	TEST_CHECK(MEMP_DESC_STATS(&memp_TEST_BIG)->max == TEST_NUM);
+	TEST_CHECK(MEMP_DESC_STATS(&memp_TEST_BIG)->err == 1);
+#endif
+
+	for (i = 0; i < TEST_NUM; i++)
+	{
+		TEST_CHECK(elements[i][TEST_SIZE - 1] == (uint8_t) i);
+		memp_free_pool (&memp_TEST_BIG, elements[i]);
+	}
+#if MEMP_STATS
+	TEST_CHECK(MEMP_DESC_STATS(&memp_TEST_BIG)->used == 0);
+#endif
+
+	free (elements);
+	printf ("test_large_pools: OK (%llu elements, %llu bytes)\n", (unsigned long long) TEST_NUM,
+			(unsigned long long) (TEST_NUM * MEMP_ELEMENT_STRIDE(memp_TEST_BIG.size)));
+	return 0;
+}